@@ -72,6 +72,10 @@ void addtopartlist(struct partinfo**, struct partinfo*, struct partinfo *refi);
 #define SPLITVERSION       "2.1"
 
 #define PARTSDIR          "parts/"
+#define DEPOTINDEX        ".index"
+#define DEPOTINDEXMAGIC   "dpkg-split depot index 2"
+#define DEPOTINDEXEND     "end"
+#define DEPOTLOCK         ".lock"
 
 #define PARTMAGIC         "debian-split"
 #define HEADERALLOWANCE    1024
@@ -25,6 +25,21 @@
  * parts are named
  *  <md5sum>.<maxpartlen>.<thispartn>.<maxpartn>
  * all numbers in hex
+ *
+ * The header information of the parts in the queue is cached in the
+ * index file (.index in the same directory), which starts with the
+ * modification time the directory had when the index was written, and
+ * has one line per part:
+ *  <name> <fmtversion> <package> <version> <md5sum> <orglength>
+ *  <maxpartlen> <thispartn> <maxpartn> <thispartlen> <headerlen> <filesize>
+ * all numbers in decimal, followed by an "end" line. As long as the
+ * directory has not changed since, the index is authoritative, and --auto
+ * does not need to read the directory nor the part headers; otherwise the
+ * directory is scanned, and only the headers of the parts missing from the
+ * index are read. The size and type
+ * of the parts are checked before using them. The operations changing the
+ * queue hold a write lock on the .lock file in the same directory, so that
+ * concurrent runs do not lose parts, and listing it holds a read lock.
  */
 
 #include <config.h>
@@ -33,6 +48,7 @@
 #include <sys/stat.h>
 
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include <string.h>
 #include <fcntl.h>
@@ -45,6 +61,7 @@
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
 #include <dpkg/dir.h>
+#include <dpkg/buffer.h>
 #include <dpkg/myopt.h>
 
 #include "dpkg-split.h"
@@ -107,6 +124,399 @@ void scandepot(void) {
   closedir(depot);
 }
 
+static char *
+depot_path(const char *name)
+{
+  char *p;
+
+  p = nfmalloc(strlen(opt_depotdir) + strlen(name) + 1);
+  strcpy(p, opt_depotdir);
+  strcat(p, name);
+
+  return p;
+}
+
+static bool
+index_parse_field(char **next, const char **field)
+{
+  char *p = *next;
+
+  if (!*p)
+    return false;
+  *field = p;
+  p += strcspn(p, " ");
+  if (*p)
+    *p++ = '\0';
+  *next = p;
+
+  return true;
+}
+
+static bool
+index_parse_ulong(char **next, unsigned long *value)
+{
+  const char *field;
+  char *endp;
+
+  if (!index_parse_field(next, &field))
+    return false;
+  *value = strtoul(field, &endp, 10);
+
+  return endp != field && *endp == '\0';
+}
+
+static bool
+index_parse_line(char *line, struct partinfo *pi)
+{
+  const char *name;
+  unsigned long thispartn, maxpartn, thispartlen, headerlen, filesize;
+
+  if (!index_parse_field(&line, &name) ||
+      !index_parse_field(&line, &pi->fmtversion) ||
+      !index_parse_field(&line, &pi->package) ||
+      !index_parse_field(&line, &pi->version) ||
+      !index_parse_field(&line, &pi->md5sum) ||
+      !index_parse_ulong(&line, &pi->orglength) ||
+      !index_parse_ulong(&line, &pi->maxpartlen) ||
+      !index_parse_ulong(&line, &thispartn) ||
+      !index_parse_ulong(&line, &maxpartn) ||
+      !index_parse_ulong(&line, &thispartlen) ||
+      !index_parse_ulong(&line, &headerlen) ||
+      !index_parse_ulong(&line, &filesize) ||
+      *line)
+    return false;
+  if (strchr(name, '/') || thispartn == 0 || thispartn > maxpartn ||
+      maxpartn > INT_MAX)
+    return false;
+
+  pi->filename = depot_path(name);
+  pi->thispartn = thispartn;
+  pi->maxpartn = maxpartn;
+  pi->thispartoffset = (thispartn - 1) * pi->maxpartlen;
+  pi->thispartlen = thispartlen;
+  pi->headerlen = headerlen;
+  pi->filesize = filesize;
+
+  return true;
+}
+
+/* The index lines not loaded into the queue, written back as they were. */
+static struct varbuf index_rest;
+
+/*
+ * Load the depot index into list, and the modification time the depot
+ * directory had when it was written into mtime. If md5sum is not NULL,
+ * only the parts of that package are loaded, and the other lines are kept
+ * in index_rest. Returns false if there is no usable index, in which case
+ * the caller needs to rebuild it.
+ */
+static bool
+index_read(struct partqueue **list, struct timespec *mtime,
+           const char *md5sum)
+{
+  struct varbuf vb = VARBUF_INIT;
+  struct partqueue *pq, *head = NULL;
+  char *fn, *line, *eol, *endp;
+  bool ok = false;
+  int fd;
+
+  fn = depot_path(DEPOTINDEX);
+  fd = open(fn, O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT)
+      return false;
+    ohshite(_("unable to open depot index `%.250s'"), fn);
+  }
+  fd_vbuf_copy(fd, &vb, -1, _("depot index `%.250s'"), fn);
+  close(fd);
+  varbufaddc(&vb, '\0');
+
+  line = vb.buf;
+  eol = strchr(line, '\n');
+  if (!eol || strncmp(line, DEPOTINDEXMAGIC "\n", eol - line + 1)) {
+    varbuf_destroy(&vb);
+    return false;
+  }
+
+  line = eol + 1;
+  mtime->tv_sec = strtol(line, &endp, 10);
+  if (endp == line || *endp != ' ') {
+    varbuf_destroy(&vb);
+    return false;
+  }
+  line = endp + 1;
+  mtime->tv_nsec = strtol(line, &endp, 10);
+  if (endp == line || *endp != '\n') {
+    varbuf_destroy(&vb);
+    return false;
+  }
+
+  for (line = endp + 1; *line; line = eol + 1) {
+    eol = strchr(line, '\n');
+    if (!eol)
+      break;
+    *eol = '\0';
+
+    /* The index is written in place, so only trust it if it is complete. */
+    if (strcmp(line, DEPOTINDEXEND) == 0) {
+      ok = eol[1] == '\0';
+      break;
+    }
+
+    if (md5sum && (strncmp(line, md5sum, MD5HASHLEN) != 0 ||
+                   line[MD5HASHLEN] != '.')) {
+      *eol = '\n';
+      varbufaddbuf(&index_rest, line, eol - line + 1);
+      continue;
+    }
+
+    pq = nfmalloc(sizeof(struct partqueue));
+    if (!index_parse_line(line, &pq->info))
+      break;
+    pq->info.fmtversion = nfstrsave(pq->info.fmtversion);
+    pq->info.package = nfstrsave(pq->info.package);
+    pq->info.version = nfstrsave(pq->info.version);
+    pq->info.md5sum = nfstrsave(pq->info.md5sum);
+    pq->nextinqueue = head;
+    head = pq;
+  }
+  varbuf_destroy(&vb);
+
+  /* Treat a truncated or otherwise garbled index as missing. */
+  if (!ok)
+    return false;
+
+  *list = head;
+
+  return true;
+}
+
+/*
+ * Replace the depot index with the parts in the queue, recording the
+ * current modification time of the depot directory, so that any later
+ * change to the directory makes the index stale. This needs to be called
+ * after all the changes to the directory entries have been done.
+ *
+ * The index is rewritten in place, as renaming a new one into the depot
+ * would itself change the directory. It does not need to be synced
+ * either, as an index left incomplete or stale after a crash is detected
+ * and rebuilt. Parts which have been removed from the depot are expected
+ * to have a NULL md5sum, as junk files do.
+ */
+static void
+index_write(void)
+{
+  struct partqueue *pq;
+  struct stat stab;
+  const char *name;
+  char *fn;
+  FILE *fp;
+  int fd;
+
+  fn = depot_path(DEPOTINDEX);
+
+  fd = open(fn, O_WRONLY | O_CREAT, 0644);
+  if (fd < 0)
+    ohshite(_("unable to open depot index `%.250s'"), fn);
+  /* Creating the index changes the directory, so check it afterwards. */
+  if (stat(opt_depotdir, &stab))
+    ohshite(_("unable to stat depot directory `%.250s'"), opt_depotdir);
+  if (ftruncate(fd, 0))
+    ohshite(_("unable to truncate depot index `%.250s'"), fn);
+  fp = fdopen(fd, "w");
+  if (!fp)
+    ohshite(_("unable to open depot index `%.250s'"), fn);
+
+  fprintf(fp, "%s\n", DEPOTINDEXMAGIC);
+  fprintf(fp, "%ld %ld\n", (long)stab.st_mtim.tv_sec,
+          (long)stab.st_mtim.tv_nsec);
+  fwrite(index_rest.buf, 1, index_rest.used, fp);
+  for (pq = queue; pq; pq = pq->nextinqueue) {
+    if (!pq->info.md5sum || !pq->info.package)
+      continue;
+    name = strrchr(pq->info.filename, '/');
+    name = name ? name + 1 : pq->info.filename;
+    fprintf(fp, "%s %s %s %s %s %lu %lu %u %u %lu %lu %lu\n", name,
+            pq->info.fmtversion, pq->info.package, pq->info.version,
+            pq->info.md5sum, pq->info.orglength, pq->info.maxpartlen,
+            pq->info.thispartn, pq->info.maxpartn,
+            (unsigned long)pq->info.thispartlen,
+            (unsigned long)pq->info.headerlen,
+            (unsigned long)pq->info.filesize);
+  }
+  fprintf(fp, "%s\n", DEPOTINDEXEND);
+  if (ferror(fp))
+    werr(fn);
+  if (fclose(fp))
+    werr(fn);
+}
+
+static int depot_lockfd = -1;
+
+static void
+cu_depot_unlock(int argc, void **argv)
+{
+  struct flock fl;
+
+  fl.l_type = F_UNLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = 0;
+  fl.l_len = 0;
+
+  if (fcntl(depot_lockfd, F_SETLK, &fl) == -1)
+    ohshite(_("unable to unlock depot directory"));
+}
+
+/*
+ * Lock the depot, for writing or for reading. If the depot cannot be
+ * written to and the lock file cannot be opened, readers go ahead without
+ * a lock, as they would not be able to list the depot otherwise.
+ */
+static void
+depot_lock(bool write)
+{
+  struct flock fl;
+  char *fn;
+
+  fn = depot_path(DEPOTLOCK);
+  if (write)
+    depot_lockfd = open(fn, O_RDWR | O_CREAT, 0644);
+  else
+    depot_lockfd = open(fn, O_RDONLY);
+  if (depot_lockfd == -1) {
+    if (!write && (errno == ENOENT || errno == EACCES))
+      return;
+    ohshite(_("unable to open depot lock file `%.250s'"), fn);
+  }
+  setcloexec(depot_lockfd, fn);
+
+  fl.l_type = write ? F_WRLCK : F_RDLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = 0;
+  fl.l_len = 0;
+
+  if (fcntl(depot_lockfd, F_SETLKW, &fl) == -1)
+    ohshite(_("unable to lock depot directory"));
+
+  push_cleanup(cu_depot_unlock, ~0, NULL, 0, 0);
+}
+
+#define DEPOT_HASH_SIZE 1024
+
+static unsigned int
+depot_hash(const char *name)
+{
+  unsigned int h = 0;
+
+  while (*name)
+    h = h * 33 + (unsigned char)*name++;
+
+  return h % DEPOT_HASH_SIZE;
+}
+
+/*
+ * Scan the depot directory, taking the part headers from the cached
+ * entries of the index, so that only the headers of the parts missing
+ * from it need to be read.
+ */
+static void
+depot_rescan(struct partqueue *cached)
+{
+  struct partqueue *pq, *cq, **buckets;
+  unsigned int h;
+
+  scandepot();
+
+  buckets = nfmalloc(sizeof(*buckets) * DEPOT_HASH_SIZE);
+  for (h = 0; h < DEPOT_HASH_SIZE; h++)
+    buckets[h] = NULL;
+  while ((cq = cached)) {
+    cached = cq->nextinqueue;
+    h = depot_hash(cq->info.filename);
+    cq->nextinqueue = buckets[h];
+    buckets[h] = cq;
+  }
+
+  for (pq = queue; pq; pq = pq->nextinqueue) {
+    if (!pq->info.md5sum)
+      continue;
+    h = depot_hash(pq->info.filename);
+    for (cq = buckets[h]; cq; cq = cq->nextinqueue)
+      if (strcmp(cq->info.filename, pq->info.filename) == 0)
+        break;
+    if (cq)
+      pq->info = cq->info;
+    else
+      mustgetpartinfo(pq->info.filename, &pq->info);
+  }
+}
+
+/*
+ * Load the queue. The index is authoritative as long as the depot
+ * directory has not changed since it was written, in which case only the
+ * parts of the package with md5sum are loaded from it, and the directory
+ * is not read at all. If md5sum is NULL, or the index is missing or stale,
+ * the whole directory is scanned instead, including the junk files.
+ */
+static void
+depot_load(const char *md5sum)
+{
+  struct partqueue *cached = NULL;
+  struct timespec mtime;
+  struct stat stab;
+
+  if (md5sum && index_read(&cached, &mtime, md5sum)) {
+    if (stat(opt_depotdir, &stab))
+      ohshite(_("unable to stat depot directory `%.250s'"), opt_depotdir);
+    if (stab.st_mtim.tv_sec == mtime.tv_sec &&
+        stab.st_mtim.tv_nsec == mtime.tv_nsec) {
+      queue = cached;
+      return;
+    }
+  }
+
+  varbufreset(&index_rest);
+  cached = NULL;
+  index_read(&cached, &mtime, NULL);
+  depot_rescan(cached);
+}
+
+/*
+ * Check that a queued part is still a plain file of the size recorded,
+ * rereading its header otherwise. Returns false if the part is gone.
+ */
+static bool
+part_check(struct partinfo *pi)
+{
+  struct stat stab;
+
+  if (lstat(pi->filename, &stab)) {
+    if (errno == ENOENT)
+      return false;
+    ohshite(_("unable to stat `%.250s'"), pi->filename);
+  }
+  if (!S_ISREG(stab.st_mode))
+    ohshit(_("part file `%.250s' is not a plain file"), pi->filename);
+  if (stab.st_size != pi->filesize)
+    mustgetpartinfo(pi->filename, pi);
+
+  return true;
+}
+
+/* Check all the queued parts, dropping the ones which are gone. */
+static void
+depot_check(void)
+{
+  struct partqueue **pqp;
+
+  for (pqp = &queue; *pqp; ) {
+    if ((*pqp)->info.md5sum && !part_check(&(*pqp)->info))
+      *pqp = (*pqp)->nextinqueue;
+    else
+      pqp = &(*pqp)->nextinqueue;
+  }
+}
+
 static bool
 partmatches(struct partinfo *pi, struct partinfo *refi)
 {
@@ -118,7 +528,7 @@ partmatches(struct partinfo *pi, struct partinfo *refi)
 
 void do_auto(const char *const *argv) {
   const char *partfile;
-  struct partinfo *pi, *refi, *npi, **partlist, *otherthispart;
+  struct partinfo *pi, *refi, **partlist, *otherthispart;
   struct partqueue *pq;
   unsigned int i;
   int j, ap;
@@ -142,16 +552,20 @@ void do_auto(const char *const *argv) {
     exit(1);
   }
   fclose(part);
-  scandepot();
+  depot_lock(true);
+  depot_load(refi->md5sum);
   partlist= nfmalloc(sizeof(struct partinfo*)*refi->maxpartn);
   for (i = 0; i < refi->maxpartn; i++)
     partlist[i] = NULL;
   for (pq= queue; pq; pq= pq->nextinqueue) {
     pi= &pq->info;
     if (!partmatches(pi,refi)) continue;
-    npi= nfmalloc(sizeof(struct partinfo));
-    mustgetpartinfo(pi->filename,npi);
-    addtopartlist(partlist,npi,refi);
+    if (!part_check(pi)) {
+      pi->md5sum= NULL;
+      continue;
+    }
+    if (!partmatches(pi,refi)) continue;
+    addtopartlist(partlist,pi,refi);
   }
   /* If we already have a copy of this version we ignore it and prefer the
    * new one, but we still want to delete the one in the depot, so we
@@ -188,6 +602,20 @@ void do_auto(const char *const *argv) {
     if (fclose(part)) werr(p);
     if (rename(p,q)) ohshite(_("unable to rename new depot file `%.250s' to `%.250s'"),p,q);
 
+    /* If we get interrupted before the index is updated, it is left stale
+     * and the depot gets scanned again next time. */
+    if (otherthispart) {
+      pi= otherthispart;
+    } else {
+      pq= nfmalloc(sizeof(struct partqueue));
+      pq->nextinqueue= queue;
+      queue= pq;
+      pi= &pq->info;
+    }
+    *pi= *refi;
+    pi->filename= q;
+    index_write();
+
     printf(_("Part %d of package %s filed (still want "),refi->thispartn,refi->package);
     /* There are still some parts missing. */
     for (i=0, ap=0; i<refi->maxpartn; i++)
@@ -203,11 +631,16 @@ void do_auto(const char *const *argv) {
 
     /* OK, delete all the parts (except the new one, which we never copied). */
     partlist[refi->thispartn-1]= otherthispart;
-    for (i=0; i<refi->maxpartn; i++)
-      if (partlist[i])
-        if (unlink(partlist[i]->filename))
-          ohshite(_("unable to delete used-up depot file `%.250s'"),partlist[i]->filename);
+    for (i=0; i<refi->maxpartn; i++) {
+      if (!partlist[i])
+        continue;
+      if (unlink(partlist[i]->filename))
+        ohshite(_("unable to delete used-up depot file `%.250s'"),partlist[i]->filename);
+      partlist[i]->md5sum= NULL;
+    }
 
+    index_write();
+    dir_sync_path(opt_depotdir);
   }
 
   m_output(stderr, _("<standard error>"));
@@ -223,7 +656,9 @@ void do_queue(const char *const *argv) {
 
   if (*argv)
     badusage(_("--%s takes no arguments"), cipaction->olong);
-  scandepot();
+  depot_lock(false);
+  depot_load(NULL);
+  depot_check();
 
   head= N_("Junk files left around in the depot directory:\n");
   for (pq= queue; pq; pq= pq->nextinqueue) {
@@ -243,7 +678,7 @@ void do_queue(const char *const *argv) {
   head= N_("Packages not yet reassembled:\n");
   for (pq= queue; pq; pq= pq->nextinqueue) {
     if (!pq->info.md5sum) continue;
-    mustgetpartinfo(pq->info.filename,&ti);
+    ti= pq->info;
     fputs(gettext(head),stdout); head= "";
     printf(_(" Package %s: part(s) "), ti.package);
     bytes= 0;
@@ -253,11 +688,7 @@ void do_queue(const char *const *argv) {
            qq= qq->nextinqueue);
       if (qq) {
         printf("%d ",i+1);
-        if (lstat(qq->info.filename,&stab))
-          ohshite(_("unable to stat `%.250s'"),qq->info.filename);
-        if (!S_ISREG(stab.st_mode))
-          ohshit(_("part file `%.250s' is not a plain file"),qq->info.filename);
-        bytes+= stab.st_size;
+        bytes+= qq->info.filesize;
         qq->info.md5sum= NULL; /* don't find this package again */
       }
     }
@@ -286,22 +717,24 @@ static void discardsome(enum discardwhich which, const char *package) {
     }
     if (unlink(pq->info.filename))
       ohshite(_("unable to discard `%.250s'"),pq->info.filename);
+    pq->info.md5sum= NULL;
     printf(_("Deleted %s.\n"),pq->info.filename);
   }
 }
 
 void do_discard(const char *const *argv) {
   const char *thisarg;
-  struct partqueue *pq;
 
-  scandepot();
+  depot_lock(true);
   if (*argv) {
-    for (pq= queue; pq; pq= pq->nextinqueue)
-      if (pq->info.md5sum)
-        mustgetpartinfo(pq->info.filename,&pq->info);
+    depot_load(NULL);
+    depot_check();
     discardsome(ds_junk,NULL);
     while ((thisarg= *argv++)) discardsome(ds_package,thisarg);
   } else {
+    scandepot();
     discardsome(ds_all,NULL);
   }
+  index_write();
+  dir_sync_path(opt_depotdir);
 }
@@ -122,7 +122,6 @@ mksplit(const char *file_src, const char *prefix, size_t partsize,
 	struct varbuf file_dst = VARBUF_INIT;
 	struct varbuf partmagic = VARBUF_INIT;
 	struct varbuf partname = VARBUF_INIT;
-	char *partdata;
 
 	fd_src = open(file_src, O_RDONLY);
 	if (fd_src < 0)
@@ -159,12 +158,11 @@ mksplit(const char *file_src, const char *prefix, size_t partsize,
 		prefix = clean_msdos_filename(msdos_prefix);
 	}
 
-	partdata = m_malloc(partsize);
 	curpart = 1;
 
 	for (startat = 0; startat < st.st_size; startat += partsize) {
 		int fd_dst;
-		ssize_t partrealsize;
+		off_t partrealsize;
 
 		varbufreset(&file_dst);
 		/* Generate output filename. */
@@ -183,10 +181,7 @@ mksplit(const char *file_src, const char *prefix, size_t partsize,
 			             prefix, curpart, nparts);
 		}
 
-		/* Read data from the original package. */
-		partrealsize = read(fd_src, partdata, partsize);
-		if (partrealsize < 0)
-			ohshite("mksplit: read");
+		partrealsize = min(st.st_size - startat, (off_t)partsize);
 
 		if ((size_t)partrealsize > maxpartsize) {
 			ohshit("Header is too long, making part too long. "
@@ -211,10 +206,11 @@ mksplit(const char *file_src, const char *prefix, size_t partsize,
 		                       partmagic.buf, partmagic.used);
 		varbufreset(&partmagic);
 
-		/* Write the data part. */
+		/* Write the data part, copied straight from the original
+		 * package without going through a userspace buffer. */
 		varbufprintf(&partname, "data.%d", curpart);
-		dpkg_ar_member_put_mem(file_dst.buf, fd_dst, partname.buf,
-		                       partdata, (size_t)partrealsize);
+		dpkg_ar_member_put_file(file_dst.buf, fd_dst, partname.buf,
+		                        fd_src, partrealsize);
 		varbufreset(&partname);
 
 		close(fd_dst);
@@ -227,7 +223,6 @@ mksplit(const char *file_src, const char *prefix, size_t partsize,
 	varbuf_destroy(&file_dst);
 	varbuf_destroy(&partname);
 	varbuf_destroy(&partmagic);
-	free(partdata);
 
 	free(prefixdir);
 	free(msdos_prefix);
@@ -0,0 +1,72 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * bench.h - benchmark support
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBDPKG_BENCH_H
+#define LIBDPKG_BENCH_H
+
+#include <time.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/dpkg.h>
+
+/*
+ * Each result is printed as a JSON object on a line of its own, so that
+ * the output of a "make bench" run can be kept and compared against the
+ * one from another release.
+ */
+
+static inline double
+bench_time(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		ohshite("cannot get the current time");
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline void
+bench_report(const char *bench, const char *name, unsigned long ops,
+             double start)
+{
+	double seconds = bench_time() - start;
+
+	printf("{\"bench\":\"%s\",\"case\":\"%s\",\"ops\":%lu,"
+	       "\"seconds\":%.6f,\"ns_per_op\":%.1f}\n",
+	       bench, name, ops, seconds, ops ? seconds * 1e9 / ops : 0.0);
+}
+
+/* The admin directory generated by gen-admindir for the benchmarks. */
+static inline const char *
+bench_admindir(void)
+{
+	const char *admindir;
+
+	admindir = getenv("BENCH_ADMINDIR");
+	if (admindir == NULL)
+		ohshit("BENCH_ADMINDIR is not set, run the benchmarks with "
+		       "\"make bench\"");
+
+	return admindir;
+}
+
+#endif
@@ -26,6 +26,7 @@
 #include <sys/types.h>
 
 #include <errno.h>
+#include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -201,6 +202,53 @@ buffer_hash(const void *input, void *output, int type, off_t limit)
 	return ret;
 }
 
+#ifdef HAVE_COPY_FILE_RANGE
+/*
+ * Copy between file descriptors inside the kernel, so that the data does
+ * not need to be bounced through a userspace buffer. Returns true if the
+ * copy has been completed, or false if the caller needs to continue with
+ * the generic read/write loop, either because the descriptors are not
+ * supported (pipes, sockets, cross-filesystem on old kernels, etc) or to
+ * properly diagnose a premature end of file.
+ */
+static bool
+buffer_copy_range(int fd_in, int fd_out, off_t *limit, off_t *copied,
+                  const char *desc)
+{
+	ssize_t n;
+	size_t len;
+
+	while (*limit != 0) {
+		if (*limit == -1 || *limit > 0x40000000)
+			len = 0x40000000;
+		else
+			len = *limit;
+
+		n = copy_file_range(fd_in, NULL, fd_out, NULL, len, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EXDEV || errno == EINVAL ||
+			    errno == EBADF || errno == ENOSYS ||
+			    errno == EOPNOTSUPP || errno == ETXTBSY)
+				return false;
+			ohshite(_("failed in write on buffer copy for %s"),
+			        desc);
+		}
+		/* Some pseudo-filesystems report a bogus end of file, so
+		 * let the generic code double check an empty first copy. */
+		if (n == 0)
+			return *limit == -1 && *copied > 0;
+
+		*copied += n;
+		if (*limit != -1)
+			*limit -= n;
+	}
+
+	return true;
+}
+#endif
+
 off_t
 buffer_copy(struct buffer_data *read_data, struct buffer_data *write_data,
             off_t limit, const char *desc)
@@ -210,10 +258,18 @@ buffer_copy(struct buffer_data *read_data, struct buffer_data *write_data,
 	long bytesread = 0, byteswritten = 0;
 	off_t totalread = 0, totalwritten = 0;
 
+#ifdef HAVE_COPY_FILE_RANGE
+	if (read_data->type == BUFFER_READ_FD &&
+	    write_data->type == BUFFER_WRITE_FD &&
+	    buffer_copy_range(read_data->arg.i, write_data->arg.i,
+	                      &limit, &totalread, desc))
+		return totalread;
+#endif
+
 	if ((limit != -1) && (limit < bufsize))
 		bufsize = limit;
 	if (bufsize == 0)
-		return 0;
+		return totalread;
 
 	buf = m_malloc(bufsize);
 
@@ -59,6 +59,7 @@ static unsigned int hash(const char *name) {
 void blankversion(struct versionrevision *version) {
   version->epoch= 0;
   version->version= version->revision= NULL;
+  version->version_key = version->revision_key = NULL;
 }
 
 void blankpackage(struct pkginfo *pigp) {
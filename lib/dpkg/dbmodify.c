@@ -44,6 +44,7 @@
 #include <dpkg/file.h>
 #include <dpkg/dir.h>
 #include <dpkg/triglib.h>
+#include <dpkg/timing.h>
 
 static enum modstatdb_rw cstatus=-1, cflags=0;
 static char *statusfile, *availablefile;
@@ -273,6 +274,7 @@ void modstatdb_checkpoint(void) {
   int i;
 
   assert(cstatus >= msdbrw_write);
+  dir_sync_deferred();
   writedb(statusfile,0,1);
   
   for (i=0; i<nextupdate; i++) {
@@ -285,14 +287,21 @@ void modstatdb_checkpoint(void) {
   dir_sync_path(updatesdir);
 
   nextupdate= 0;
+
+  log_flush();
 }
 
-void modstatdb_shutdown(void) {
+static void
+modstatdb_done(bool checkpoint)
+{
   const struct fni *fnip;
   switch (cstatus) {
   case msdbrw_write:
-    modstatdb_checkpoint();
-    writedb(availablefile,1,0);
+    if (checkpoint)
+      modstatdb_checkpoint();
+    /* Do not throw away the available database if we did not load it. */
+    if (!(cflags & msdbrw_noavail))
+      writedb(availablefile,1,0);
     /* tidy up a bit, but don't worry too much about failure */
     fclose(importanttmp);
     unlink(importanttmpfile);
@@ -311,11 +320,30 @@ void modstatdb_shutdown(void) {
   free(updatefnbuf);
 }
 
+void modstatdb_shutdown(void) {
+  modstatdb_done(true);
+}
+
+/*
+ * For writers which ended up not changing anything themselves, so that the
+ * status file is only rewritten if there are journalled updates to fold in.
+ */
+void
+modstatdb_shutdown_unchanged(void)
+{
+  modstatdb_done(nextupdate > 0);
+}
+
 static void
 modstatdb_note_core(struct pkginfo *pkg)
 {
   assert(cstatus >= msdbrw_write);
 
+  timing_start(timing_modstatdb_note);
+
+  /* Any file renames this status relies on must hit the disk first. */
+  dir_sync_deferred();
+
   varbufreset(&uvb);
   varbufrecord(&uvb, pkg, &pkg->installed);
 
@@ -325,11 +353,13 @@ modstatdb_note_core(struct pkginfo *pkg)
     ohshite(_("unable to flush updated status of `%.250s'"), pkg->name);
   if (ftruncate(fileno(importanttmp), uvb.used))
     ohshite(_("unable to truncate for updated status of `%.250s'"), pkg->name);
+  timing_count(timing_fsync);
   if (fsync(fileno(importanttmp)))
     ohshite(_("unable to fsync updated status of `%.250s'"), pkg->name);
   if (fclose(importanttmp))
     ohshite(_("unable to close updated status of `%.250s'"), pkg->name);
   sprintf(updatefnrest, IMPORTANTFMT, nextupdate);
+  timing_count(timing_rename);
   if (rename(importanttmpfile, updatefnbuf))
     ohshite(_("unable to install updated status of `%.250s'"), pkg->name);
 
@@ -346,6 +376,8 @@ modstatdb_note_core(struct pkginfo *pkg)
   }
 
   createimptmp();
+
+  timing_stop(timing_modstatdb_note);
 }
 
 /* Note: If anyone wants to set some triggers-pending, they must also
@@ -376,6 +408,14 @@ void modstatdb_note(struct pkginfo *pkg) {
 	      versiondescribe(&pkg->installed.version, vdew_nonambig));
   statusfd_send("status: %s: %s", pkg->name, statusinfos[pkg->status].name);
 
+  statusfd_event_begin("status");
+  statusfd_event_string("package", pkg->name);
+  statusfd_event_string("status", statusinfos[pkg->status].name);
+  statusfd_event_string("version",
+                        versiondescribe(&pkg->installed.version, vdew_nonambig));
+  statusfd_event_end();
+  statusfd_event_flush();
+
   if (cstatus >= msdbrw_write)
     modstatdb_note_core(pkg);
 
@@ -34,6 +34,7 @@
 #include <dpkg/i18n.h>
 #include <dpkg/varbuf.h>
 #include <dpkg/dir.h>
+#include <dpkg/timing.h>
 
 void
 dir_sync(DIR *dir, const char *path)
@@ -45,6 +46,7 @@ dir_sync(DIR *dir, const char *path)
 		ohshite(_("unable to get file descriptor for directory '%s'"),
 		        path);
 
+	timing_count(timing_fsync);
 	if (fsync(fd))
 		ohshite(_("unable to sync directory '%s'"), path);
 }
@@ -63,6 +65,55 @@ dir_sync_path(const char *path)
 	closedir(dir);
 }
 
+/*
+ * Directories whose sync has been deferred with dir_sync_path_deferred().
+ */
+struct dir_sync_pending {
+	struct dir_sync_pending *next;
+	char *path;
+};
+
+static struct dir_sync_pending *dir_sync_pending;
+
+/**
+ * Note that a directory needs to be synced, but do not do it yet.
+ *
+ * This allows batching the syncs of a directory where several entries
+ * get renamed in a row. The caller must make sure dir_sync_deferred()
+ * gets called before anything that relies on the renames being on disk.
+ */
+void
+dir_sync_path_deferred(const char *path)
+{
+	struct dir_sync_pending *pending;
+
+	for (pending = dir_sync_pending; pending; pending = pending->next)
+		if (strcmp(pending->path, path) == 0)
+			return;
+
+	pending = m_malloc(sizeof(*pending));
+	pending->path = m_strdup(path);
+	pending->next = dir_sync_pending;
+	dir_sync_pending = pending;
+}
+
+/**
+ * Sync all the directories noted with dir_sync_path_deferred().
+ */
+void
+dir_sync_deferred(void)
+{
+	struct dir_sync_pending *pending;
+
+	while ((pending = dir_sync_pending)) {
+		dir_sync_path(pending->path);
+
+		dir_sync_pending = pending->next;
+		free(pending->path);
+		free(pending);
+	}
+}
+
 void
 dir_sync_path_parent(const char *path)
 {
@@ -92,6 +143,7 @@ dir_file_sync(const char *dir, const char *filename)
 	fd = open(path.buf, O_WRONLY);
 	if (fd < 0)
 		ohshite(_("unable to open file '%s'"), path.buf);
+	timing_count(timing_fsync);
 	if (fsync(fd))
 		ohshite(_("unable to sync file '%s'"), path.buf);
 	if (close(fd))
@@ -122,3 +174,60 @@ dir_sync_contents(const char *path)
 
 	closedir(dir);
 }
+
+/**
+ * Get a descriptor for the directory containing pathname.
+ *
+ * The descriptor of the last directory is kept open in the cache, and
+ * reused while the following pathnames are in the same directory. The
+ * caller must close the cache whenever that directory or any of its
+ * parents might have been replaced.
+ *
+ * @param cache The directory cache.
+ * @param pathname The pathname of the object to operate on.
+ * @param name Set to the part of pathname relative to the descriptor.
+ *
+ * @return The directory descriptor, or AT_FDCWD if the directory could not
+ *         be opened, in which case name is the whole pathname, so that any
+ *         error gets reported by the operation itself.
+ */
+int
+dir_cache_open(struct dir_cache *cache, const char *pathname,
+               const char **name)
+{
+	const char *slash;
+	size_t dirlen;
+
+	slash = strrchr(pathname, '/');
+	if (slash == NULL || slash == pathname || slash[1] == '\0') {
+		*name = pathname;
+		return AT_FDCWD;
+	}
+	dirlen = slash - pathname;
+
+	if (cache->path.used != dirlen + 1 ||
+	    memcmp(cache->path.buf, pathname, dirlen) != 0) {
+		dir_cache_close(cache);
+
+		varbufaddbuf(&cache->path, pathname, dirlen);
+		varbufaddc(&cache->path, '\0');
+
+		cache->fd = open(cache->path.buf, O_RDONLY | O_DIRECTORY);
+		if (cache->fd < 0) {
+			varbufreset(&cache->path);
+			*name = pathname;
+			return AT_FDCWD;
+		}
+	}
+
+	*name = slash + 1;
+	return cache->fd;
+}
+
+void
+dir_cache_close(struct dir_cache *cache)
+{
+	if (cache->path.used)
+		close(cache->fd);
+	varbufreset(&cache->path);
+}
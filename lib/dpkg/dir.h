@@ -25,13 +25,31 @@
 
 #include <dirent.h>
 
+#include <dpkg/varbuf.h>
+
 DPKG_BEGIN_DECLS
 
+/*
+ * Cache of the descriptor of the last directory used, so that operations
+ * on consecutive objects in the same directory can be done relative to it
+ * with the *at() functions. It must be zero-initialized.
+ */
+struct dir_cache {
+	struct varbuf path;
+	int fd;
+};
+
 void dir_sync(DIR *dir, const char *path);
 void dir_sync_path(const char *path);
 void dir_sync_path_parent(const char *path);
+void dir_sync_path_deferred(const char *path);
+void dir_sync_deferred(void);
 void dir_sync_contents(const char *path);
 
+int dir_cache_open(struct dir_cache *cache, const char *pathname,
+                   const char **name);
+void dir_cache_close(struct dir_cache *cache);
+
 DPKG_END_DECLS
 
 #endif /* LIBDPKG_DIR_H */
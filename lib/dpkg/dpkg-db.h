@@ -32,10 +32,17 @@
 
 DPKG_BEGIN_DECLS
 
+struct versionkey;
+
 struct versionrevision {
   unsigned long epoch;
   const char *version;
   const char *revision;
+  /* Pre-tokenized version and revision, set by parseversion(), used by
+   * versioncompare() when available. They need to be reset whenever the
+   * strings are changed. */
+  const struct versionkey *version_key;
+  const struct versionkey *revision_key;
 };  
 
 enum deptype {
@@ -78,6 +85,15 @@ struct deppossi {
   struct versionrevision version;
   enum depverrel verrel;
   bool cyclebreak;
+
+  /* Result of the last versionsatisfied() check against this relation,
+   * keyed on the version it was checked with. As version strings are
+   * never modified nor freed, comparing their addresses is enough to
+   * tell if the cached result is still valid. */
+  struct {
+    struct versionrevision version;
+    bool valid, satisfied;
+  } cache;
 };
 
 struct arbitraryfield {
@@ -207,6 +223,7 @@ void modstatdb_note(struct pkginfo *pkg);
 void modstatdb_note_ifwrite(struct pkginfo *pkg);
 void modstatdb_checkpoint(void);
 void modstatdb_shutdown(void);
+void modstatdb_shutdown_unchanged(void);
 
 const char *pkgadmindir(void);
 const char *pkgadminfile(struct pkginfo *pkg, const char *whichfile);
@@ -284,6 +301,7 @@ bool versionsatisfied(struct pkginfoperfile *it, struct deppossi *against);
 bool versionsatisfied3(const struct versionrevision *it,
                        const struct versionrevision *ref,
                        enum depverrel verrel);
+void tokenizeversion(struct versionrevision *version);
 int versioncompare(const struct versionrevision *version,
                    const struct versionrevision *refversion);
 bool epochsdiffer(const struct versionrevision *a,
@@ -26,6 +26,7 @@
 
 #include <setjmp.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -65,6 +66,7 @@ DPKG_BEGIN_DECLS
 #define LOCKFILE          "lock"
 #define DIVERSIONSFILE    "diversions"
 #define STATOVERRIDEFILE  "statoverride"
+#define QUERYSOCKETFILE   "query.sock"
 #define UPDATESDIR        "updates/"
 #define INFODIR           "info/"
 #define TRIGGERSDIR       "triggers/"
@@ -154,6 +156,7 @@ void warning(const char *fmt, ...) DPKG_ATTR_PRINTF(1);
 
 extern const char *log_file;
 void log_message(const char *fmt, ...) DPKG_ATTR_PRINTF(1);
+void log_flush(void);
 
 /* FIXME: pipef and status_pipes should not be publicly exposed. */
 struct pipef {
@@ -161,9 +164,18 @@ struct pipef {
   struct pipef *next;
 };
 extern struct pipef *status_pipes;
+extern struct pipef *status_event_pipes;
 
 void statusfd_send(const char *fmt, ...) DPKG_ATTR_PRINTF(1);
 
+double statusfd_event_clock(void);
+void statusfd_event_begin(const char *event);
+void statusfd_event_string(const char *key, const char *value);
+void statusfd_event_integer(const char *key, intmax_t value);
+void statusfd_event_seconds(const char *key, double value);
+void statusfd_event_end(void);
+void statusfd_event_flush(void);
+
 /*** cleanup.c ***/
 
 void cu_closefile(int argc, void **argv);
@@ -40,6 +40,7 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/dir.h>
 #include <dpkg/parsedump.h>
+#include <dpkg/timing.h>
 
 void w_name(struct varbuf *vb,
             const struct pkginfo *pigp, const struct pkginfoperfile *pifp,
@@ -367,6 +368,8 @@ writedb(const char *filename, bool available, bool mustsync)
   struct varbuf vb = VARBUF_INIT;
   int old_umask;
 
+  timing_start(timing_writedb);
+
   which = available ? "available" : "status";
   oldfn= m_malloc(strlen(filename)+sizeof(OLDDBEXT));
   strcpy(oldfn,filename); strcat(oldfn,OLDDBEXT);
@@ -399,6 +402,7 @@ writedb(const char *filename, bool available, bool mustsync)
   if (mustsync) {
     if (fflush(file))
       ohshite(_("failed to flush %s database to '%.250s'"), which, filename);
+    timing_count(timing_fsync);
     if (fsync(fileno(file)))
       ohshite(_("failed to fsync %s database to '%.250s'"), which, filename);
   }
@@ -409,6 +413,7 @@ writedb(const char *filename, bool available, bool mustsync)
   if (link(filename,oldfn) && errno != ENOENT)
     ohshite(_("failed to link '%.250s' to '%.250s' for backup of %s database"),
             filename, oldfn, which);
+  timing_count(timing_rename);
   if (rename(newfn,filename))
     ohshite(_("failed to install '%.250s' as '%.250s' containing %s database"),
             newfn, filename, which);
@@ -418,4 +423,6 @@ writedb(const char *filename, bool available, bool mustsync)
 
   free(newfn);
   free(oldfn);
+
+  timing_stop(timing_writedb);
 }
@@ -200,6 +200,7 @@ void f_revision(struct pkginfo *pigp, struct pkginfoperfile *pifp,
     pifp->version.version= newversion;
   }
   pifp->version.revision= nfstrsave(value);
+  tokenizeversion(&pifp->version);
 }  
 
 void f_configversion(struct pkginfo *pigp, struct pkginfoperfile *pifp,
@@ -352,6 +353,7 @@ void f_dependency(struct pkginfo *pigp, struct pkginfoperfile *pifp,
       dop->rev_prev = NULL;
 
       dop->cyclebreak = false;
+      dop->cache.valid = false;
 /* skip whitespace after packagename */
       while (isspace(*p)) p++;
       if (*p == '(') {			/* if we have a versioned relation */
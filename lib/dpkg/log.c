@@ -21,11 +21,16 @@
 #include <config.h>
 #include <compat.h>
 
+#include <sys/types.h>
+
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <stdio.h>
 
 #include <dpkg/i18n.h>
@@ -34,40 +39,101 @@
 
 const char *log_file = NULL;
 
+/*
+ * The log lines are formatted into a buffer, which is only written out
+ * by log_flush(), at the points where the database is checkpointed,
+ * before forking a maintainer script or any other subprocess, on
+ * errors and at exit, or when it gets too big; so that a large run does
+ * not cost one write per line. The timestamp is only formatted again
+ * when the second changes, and the time zone is only loaded once.
+ */
+
+#define LOG_FLUSH_SIZE 65536
+
+static int log_fd = -1;
+static pid_t log_pid;
+static struct varbuf log_vb;
+
+void
+log_flush(void)
+{
+	const char *p;
+	ssize_t r;
+	size_t l;
+
+	/* Do not write again what the parent process had buffered. */
+	if (log_fd < 0 || log_pid != getpid())
+		return;
+
+	for (p = log_vb.buf, l = log_vb.used; l; p += r, l -= r) {
+		r = write(log_fd, p, l);
+		if (r < 0) {
+			if (errno == EINTR) {
+				r = 0;
+				continue;
+			}
+			warning(_("couldn't write to log `%s': %s"), log_file,
+			        strerror(errno));
+			break;
+		}
+	}
+
+	varbufreset(&log_vb);
+}
+
+static bool
+log_open(void)
+{
+	log_fd = open(log_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (log_fd < 0) {
+		fprintf(stderr, _("couldn't open log `%s': %s\n"),
+		        log_file, strerror(errno));
+		log_file = NULL;
+		return false;
+	}
+	setcloexec(log_fd, log_file);
+
+	log_pid = getpid();
+	tzset();
+	atexit(log_flush);
+
+	return true;
+}
+
 void
 log_message(const char *fmt, ...)
 {
-	static struct varbuf log;
-	static FILE *logfd = NULL;
-	char time_str[20];
+	static char time_str[20];
+	static time_t time_last = -1;
 	time_t now;
 	va_list args;
 
 	if (!log_file)
 		return;
 
-	if (!logfd) {
-		logfd = fopen(log_file, "a");
-		if (!logfd) {
-			fprintf(stderr, _("couldn't open log `%s': %s\n"),
-			        log_file, strerror(errno));
-			log_file = NULL;
-			return;
-		}
-		setlinebuf(logfd);
-		setcloexec(fileno(logfd), log_file);
+	if (log_fd < 0 && !log_open())
+		return;
+
+	time(&now);
+	if (now != time_last) {
+		struct tm tm;
+
+		strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S",
+		         localtime_r(&now, &tm));
+		time_last = now;
 	}
 
+	varbufaddstr(&log_vb, time_str);
+	varbufaddc(&log_vb, ' ');
+
 	va_start(args, fmt);
-	varbufreset(&log);
-	varbufvprintf(&log, fmt, args);
-	varbufaddc(&log, 0);
+	varbufvprintf(&log_vb, fmt, args);
 	va_end(args);
 
-	time(&now);
-	strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S",
-	         localtime(&now));
-	fprintf(logfd, "%s %s\n", time_str, log.buf);
+	varbufaddc(&log_vb, '\n');
+
+	if (log_vb.used >= LOG_FLUSH_SIZE)
+		log_flush();
 }
 
 struct pipef *status_pipes = NULL;
@@ -104,3 +170,135 @@ statusfd_send(const char *fmt, ...)
 	}
 }
 
+
+/*
+ * The structured events are JSON objects, one per line, each carrying the
+ * format version, a monotonic timestamp in seconds and the event name.
+ * They are accumulated in a buffer and only written out when a caller
+ * asks for a flush, usually at a phase boundary, so that the common case
+ * costs one write per pipe for several events instead of one per event.
+ */
+
+#define STATUSFD_EVENT_VERSION 1
+
+struct pipef *status_event_pipes = NULL;
+
+static struct varbuf event_vb;
+
+double
+statusfd_event_clock(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		ohshite(_("unable to get the current time"));
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+statusfd_event_key(const char *key)
+{
+	varbufprintf(&event_vb, ",\"%s\":", key);
+}
+
+void
+statusfd_event_begin(const char *event)
+{
+	if (!status_event_pipes)
+		return;
+
+	varbufprintf(&event_vb, "{\"version\":%d,\"time\":%.6f,\"event\":\"%s\"",
+	             STATUSFD_EVENT_VERSION, statusfd_event_clock(), event);
+}
+
+void
+statusfd_event_string(const char *key, const char *value)
+{
+	const char *p;
+
+	if (!status_event_pipes)
+		return;
+
+	statusfd_event_key(key);
+	varbufaddc(&event_vb, '"');
+	for (p = value; *p; p++) {
+		switch (*p) {
+		case '"':
+		case '\\':
+			varbufaddc(&event_vb, '\\');
+			varbufaddc(&event_vb, *p);
+			break;
+		case '\n':
+			varbufaddstr(&event_vb, "\\n");
+			break;
+		case '\t':
+			varbufaddstr(&event_vb, "\\t");
+			break;
+		default:
+			if ((unsigned char)*p < 0x20)
+				varbufprintf(&event_vb, "\\u%04x", *p);
+			else
+				varbufaddc(&event_vb, *p);
+		}
+	}
+	varbufaddc(&event_vb, '"');
+}
+
+void
+statusfd_event_integer(const char *key, intmax_t value)
+{
+	if (!status_event_pipes)
+		return;
+
+	statusfd_event_key(key);
+	varbufprintf(&event_vb, "%jd", value);
+}
+
+void
+statusfd_event_seconds(const char *key, double value)
+{
+	if (!status_event_pipes)
+		return;
+
+	statusfd_event_key(key);
+	varbufprintf(&event_vb, "%.6f", value);
+}
+
+void
+statusfd_event_end(void)
+{
+	if (!status_event_pipes)
+		return;
+
+	varbufaddstr(&event_vb, "}\n");
+}
+
+/**
+ * Write out all the events buffered so far.
+ *
+ * This needs to be done before forking too, otherwise the child might
+ * end up writing them again.
+ */
+void
+statusfd_event_flush(void)
+{
+	struct pipef *pipef;
+	const char *p;
+	int r, l;
+
+	if (!event_vb.used)
+		return;
+
+	for (pipef = status_event_pipes; pipef; pipef = pipef->next) {
+		for (p = event_vb.buf, l = event_vb.used; l;  p += r, l -= r) {
+			r = write(pipef->fd, p, l);
+			if (r < 0)
+				ohshite(_("unable to write to status event fd %d"),
+				        pipef->fd);
+			assert(r && r <= l);
+		}
+	}
+
+	varbufreset(&event_vb);
+}
@@ -42,6 +42,7 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/parsedump.h>
 #include <dpkg/buffer.h>
+#include <dpkg/timing.h>
 
 const struct fieldinfo fieldinfos[]= {
   /* NB: capitalisation of these strings is important. */
@@ -109,6 +110,8 @@ int parsedb(const char *filename, enum parsedbflags flags,
   ps.warnto = warnto;
   ps.warncount = 0;
 
+  timing_start(timing_parsedb);
+
   newpifp= (flags & pdb_recordavailable) ? &newpig.available : &newpig.installed;
   fd= open(filename, O_RDONLY);
   if (fd == -1) ohshite(_("failed to open package info file `%.255s' for reading"),filename);
@@ -396,6 +399,8 @@ int parsedb(const char *filename, enum parsedbflags flags,
   if (warncount)
     *warncount = ps.warncount;
 
+  timing_stop(timing_parsedb);
+
   return pdone;
 }
 
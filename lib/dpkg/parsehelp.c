@@ -214,6 +214,8 @@ const char *parseversion(struct versionrevision *rversion, const char *string) {
   const char *end, *ptr;
   unsigned long epoch;
 
+  rversion->version_key = rversion->revision_key = NULL;
+
   if (!*string) return _("version string is empty");
 
   /* trim leading and trailing space */
@@ -257,6 +259,8 @@ const char *parseversion(struct versionrevision *rversion, const char *string) {
       return _("invalid character in revision number");
   }
 
+  tokenizeversion(rversion);
+
   return NULL;
 }
 
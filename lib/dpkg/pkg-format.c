@@ -43,6 +43,9 @@ struct pkg_format_node {
 	size_t width;
 	int pad;
 	char *data;
+	/* The length of a string, or the known field for a field. */
+	size_t len;
+	const struct fieldinfo *fip;
 };
 
 
@@ -57,6 +60,8 @@ pkg_format_node_new(void)
 	buf->data = NULL;
 	buf->width = 0;
 	buf->pad = 0;
+	buf->len = 0;
+	buf->fip = NULL;
 
 	return buf;
 }
@@ -64,6 +69,7 @@ pkg_format_node_new(void)
 static bool
 parsefield(struct pkg_format_node *cur, const char *fmt, const char *fmtend)
 {
+	const struct fieldinfo *fip;
 	int len;
 	const char *ws;
 
@@ -96,6 +102,14 @@ parsefield(struct pkg_format_node *cur, const char *fmt, const char *fmtend)
 	memcpy(cur->data, fmt, len);
 	cur->data[len] = '\0';
 
+	/* Resolve known fields now, so that only arbitrary fields need to
+	 * be looked up by name for each package. */
+	for (fip = fieldinfos; fip->name; fip++)
+		if (strcasecmp(cur->data, fip->name) == 0) {
+			cur->fip = fip;
+			break;
+		}
+
 	return true;
 }
 
@@ -133,6 +147,7 @@ parsestring(struct pkg_format_node *cur, const char *fmt, const char *fmtend)
 		fmt++;
 	}
 	*write = '\0';
+	cur->len = write - cur->data;
 
 	return true;
 }
@@ -200,71 +215,68 @@ pkg_format_parse(const char *fmt)
 	return head;
 }
 
-void
-pkg_format_show(const struct pkg_format_node *head,
-                struct pkginfo *pkg, struct pkginfoperfile *pif)
+static void
+pkg_format_add(struct varbuf *vb, const struct pkg_format_node *node,
+               const char *str, size_t len)
 {
-	struct varbuf vb = VARBUF_INIT, fb = VARBUF_INIT, wb = VARBUF_INIT;
+	size_t fill;
 
-	while (head) {
-		bool ok;
-		char fmt[16];
+	if (node->width == 0) {
+		varbufaddbuf(vb, str, len);
+		return;
+	}
 
-		ok = false;
+	if (len > node->width)
+		len = node->width;
+	fill = node->width - len;
+
+	if (!node->pad)
+		while (fill--)
+			varbufaddc(vb, ' ');
+	varbufaddbuf(vb, str, len);
+	if (node->pad)
+		while (fill--)
+			varbufaddc(vb, ' ');
+}
 
-		if (head->width > 0)
-			snprintf(fmt, 16, "%%%s%zds",
-			         ((head->pad) ? "-" : ""), head->width);
-		else
-			strcpy(fmt, "%s");
+/**
+ * Append the formatted package to vb.
+ */
+void
+pkg_format_print(struct varbuf *vb, const struct pkg_format_node *head,
+                 struct pkginfo *pkg, struct pkginfoperfile *pif)
+{
+	static struct varbuf wb;
 
+	for (; head; head = head->next) {
 		if (head->type == string) {
-			varbufprintf(&fb, fmt, head->data);
-			ok = true;
+			pkg_format_add(vb, head, head->data, head->len);
+		} else if (head->type == field && head->fip) {
+			varbufreset(&wb);
+			head->fip->wcall(&wb, pkg, pif, 0, head->fip);
+			varbufaddc(&wb, '\0');
+			pkg_format_add(vb, head, wb.buf, strlen(wb.buf));
 		} else if (head->type == field) {
-			const struct fieldinfo *fip;
-
-			for (fip = fieldinfos; fip->name; fip++)
-				if (strcasecmp(head->data, fip->name) == 0) {
-					fip->wcall(&wb, pkg, pif, 0, fip);
+			const struct arbitraryfield *afp;
 
-					varbufaddc(&wb, '\0');
-					varbufprintf(&fb, fmt, wb.buf);
-					varbufreset(&wb);
-					ok = true;
+			for (afp = pif->arbs; afp; afp = afp->next)
+				if (strcasecmp(head->data, afp->name) == 0) {
+					pkg_format_add(vb, head, afp->value,
+					               strlen(afp->value));
 					break;
 				}
-
-			if (!fip->name) {
-				const struct arbitraryfield *afp;
-
-				for (afp = pif->arbs; afp; afp = afp->next)
-					if (strcasecmp(head->data, afp->name) == 0) {
-						varbufprintf(&fb, fmt, afp->value);
-						ok = true;
-						break;
-					}
-			}
 		}
-
-		if (ok) {
-			size_t len = strlen(fb.buf);
-			if ((head->width > 0) && (len > head->width))
-				len = head->width;
-			varbufaddbuf(&vb, fb.buf, len);
-		}
-
-		varbufreset(&fb);
-		head = head->next;
 	}
+}
 
-	if (vb.buf) {
-		varbufaddc(&vb, '\0');
-		fputs(vb.buf, stdout);
-	}
+void
+pkg_format_show(const struct pkg_format_node *head,
+                struct pkginfo *pkg, struct pkginfoperfile *pif)
+{
+	static struct varbuf vb;
 
-	varbuf_destroy(&wb);
-	varbuf_destroy(&fb);
-	varbuf_destroy(&vb);
+	varbufreset(&vb);
+	pkg_format_print(&vb, head, pkg, pif);
+	if (vb.used)
+		fwrite(vb.buf, 1, vb.used, stdout);
 }
-
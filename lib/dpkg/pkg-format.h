@@ -23,6 +23,7 @@
 
 #include <dpkg/macros.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/varbuf.h>
 
 DPKG_BEGIN_DECLS
 
@@ -30,6 +31,8 @@ struct pkg_format_node;
 
 struct pkg_format_node *pkg_format_parse(const char *fmt);
 void pkg_format_free(struct pkg_format_node *head);
+void pkg_format_print(struct varbuf *vb, const struct pkg_format_node *head,
+                      struct pkginfo *pkg, struct pkginfoperfile *pif);
 void pkg_format_show(const struct pkg_format_node *head,
                      struct pkginfo *pkg, struct pkginfoperfile *pif);
 
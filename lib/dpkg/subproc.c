@@ -90,6 +90,9 @@ subproc_fork(void)
 {
 	pid_t r;
 
+	log_flush();
+	statusfd_event_flush();
+
 	r = fork();
 	if (r == -1) {
 		onerr_abort++;
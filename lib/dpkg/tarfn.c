@@ -26,14 +26,13 @@
 
 #include <errno.h>
 #include <string.h>
-#include <pwd.h>
-#include <grp.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 #include <dpkg/macros.h>
 #include <dpkg/dpkg.h>
+#include <dpkg/ugid.h>
 #include <dpkg/tarfn.h>
 
 #define TAR_MAGIC_USTAR "ustar\0" "00"
@@ -157,8 +156,6 @@ DecodeTarHeader(char *block, struct tar_entry *d)
 {
 	struct TarHeader *h = (struct TarHeader *)block;
 	unsigned char *s = (unsigned char *)block;
-	struct passwd *passwd = NULL;
-	struct group *group = NULL;
 	unsigned int i;
 	long sum;
 	long checksum;
@@ -188,18 +185,10 @@ DecodeTarHeader(char *block, struct tar_entry *d)
 	                sizeof(h->MajorDevice)) & 0xff) << 8) |
 	         (OtoL(h->MinorDevice, sizeof(h->MinorDevice)) & 0xff);
 
-	if (*h->UserName)
-		passwd = getpwnam(h->UserName);
-	if (passwd)
-		d->uid = passwd->pw_uid;
-	else
+	if (!*h->UserName || !ugid_user_id(h->UserName, &d->uid))
 		d->uid = (uid_t)OtoL(h->UserID, sizeof(h->UserID));
 
-	if (*h->GroupName)
-		group = getgrnam(h->GroupName);
-	if (group)
-		d->gid = group->gr_gid;
-	else
+	if (!*h->GroupName || !ugid_group_id(h->GroupName, &d->gid))
 		d->gid = (gid_t)OtoL(h->GroupID, sizeof(h->GroupID));
 
 	checksum = OtoL(h->Checksum, sizeof(h->Checksum));
@@ -0,0 +1,85 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-buffer.c - benchmark buffer copying and hashing
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/test.h>
+#include <dpkg/bench.h>
+#include <dpkg/buffer.h>
+
+/* The operations reported are the bytes copied. */
+#define FILESIZE (16 * 1024 * 1024)
+#define ROUNDS 8
+
+static int
+bench_buffer_file(void)
+{
+	FILE *file;
+	char *buf;
+	int fd;
+
+	file = tmpfile();
+	test_pass(file != NULL);
+	fd = fileno(file);
+
+	buf = m_malloc(FILESIZE);
+	memset(buf, 'x', FILESIZE);
+	test_pass(write(fd, buf, FILESIZE) == FILESIZE);
+	free(buf);
+
+	return fd;
+}
+
+static void
+test(void)
+{
+	char hash[33];
+	double start;
+	int fd, null_fd, i;
+
+	fd = bench_buffer_file();
+	null_fd = open("/dev/null", O_WRONLY);
+	test_pass(null_fd >= 0);
+
+	start = bench_time();
+	for (i = 0; i < ROUNDS; i++) {
+		lseek(fd, 0, SEEK_SET);
+		fd_fd_copy(fd, null_fd, -1, "bench fd_fd_copy");
+	}
+	bench_report("buffer", "fd_fd_copy", (unsigned long)FILESIZE * ROUNDS,
+	             start);
+
+	start = bench_time();
+	for (i = 0; i < ROUNDS; i++) {
+		lseek(fd, 0, SEEK_SET);
+		fd_md5(fd, hash, -1, "bench fd_md5");
+	}
+	bench_report("buffer", "fd_md5", (unsigned long)FILESIZE * ROUNDS,
+	             start);
+
+	close(null_fd);
+	close(fd);
+}
@@ -0,0 +1,111 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-pkg-db.c - benchmark package database parsing, lookup and dumping
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/test.h>
+#include <dpkg/bench.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/varbuf.h>
+
+#define FINDPACKAGE_ROUNDS 20
+
+static char *
+bench_admindir_file(const char *name)
+{
+	struct varbuf path = VARBUF_INIT;
+
+	varbufprintf(&path, "%s/%s", bench_admindir(), name);
+	varbufaddc(&path, '\0');
+
+	return path.buf;
+}
+
+static void
+bench_parsedb(const char *name, const char *file, enum parsedbflags flags)
+{
+	char *path = bench_admindir_file(file);
+	double start;
+	int n;
+
+	start = bench_time();
+	n = parsedb(path, flags, NULL, NULL, NULL);
+	bench_report("pkg-db", name, n, start);
+
+	test_pass(n > 0);
+
+	free(path);
+}
+
+static void
+bench_findpackage(void)
+{
+	struct pkgiterator *it;
+	struct pkginfo *pkg;
+	const char **names;
+	double start;
+	int i, n, round;
+
+	n = countpackages();
+	names = m_malloc(sizeof(names[0]) * n);
+
+	i = 0;
+	it = iterpkgstart();
+	while ((pkg = iterpkgnext(it)) && i < n)
+		names[i++] = pkg->name;
+	iterpkgend(it);
+	n = i;
+
+	start = bench_time();
+	for (round = 0; round < FINDPACKAGE_ROUNDS; round++)
+		for (i = 0; i < n; i++)
+			findpackage(names[i]);
+	bench_report("pkg-db", "findpackage", n * FINDPACKAGE_ROUNDS, start);
+
+	free(names);
+}
+
+static void
+bench_writedb(const char *name, const char *file, bool available)
+{
+	char *path = bench_admindir_file(file);
+	double start;
+
+	start = bench_time();
+	writedb(path, available, false);
+	bench_report("pkg-db", name, countpackages(), start);
+
+	free(path);
+}
+
+static void
+test(void)
+{
+	bench_parsedb("parsedb-status", STATUSFILE, 0);
+	bench_parsedb("parsedb-available", AVAILFILE,
+	              pdb_recordavailable | pdb_rejectstatus);
+	bench_findpackage();
+	bench_writedb("writedb-status", "bench-" STATUSFILE, false);
+	bench_writedb("writedb-available", "bench-" AVAILFILE, true);
+}
@@ -0,0 +1,166 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-tarfn.c - benchmark tar archive parsing
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/test.h>
+#include <dpkg/bench.h>
+#include <dpkg/tarfn.h>
+
+#define NENTRIES 20000
+
+/*
+ * The archive is built in memory, with the directories, files and
+ * symlinks in the same proportions as in a package with many small
+ * files, and is then parsed without touching the file system, so that
+ * only the cost of tar_extractor() itself is measured.
+ */
+
+struct bench_tar {
+	char *buf;
+	size_t size;
+	size_t pos;
+	int entries;
+};
+
+static void
+bench_tar_add(struct bench_tar *tar, enum tar_filetype type,
+              const char *name, const char *linkname, size_t size)
+{
+	char *h = tar->buf + tar->size;
+	unsigned int sum;
+	int i;
+
+	memset(h, 0, TARBLKSZ);
+	strcpy(h, name);
+	sprintf(h + 100, "%07o", type == tar_filetype_dir ? 0755 : 0644);
+	sprintf(h + 108, "%07o", 0);
+	sprintf(h + 116, "%07o", 0);
+	sprintf(h + 124, "%011lo", (unsigned long)size);
+	sprintf(h + 136, "%011lo", 1234567890UL);
+	h[156] = type;
+	if (linkname)
+		strcpy(h + 157, linkname);
+	memcpy(h + 257, "ustar\0" "00", 8);
+	strcpy(h + 265, "root");
+	strcpy(h + 297, "root");
+
+	memset(h + 148, ' ', 8);
+	for (sum = 0, i = 0; i < TARBLKSZ; i++)
+		sum += (unsigned char)h[i];
+	sprintf(h + 148, "%06o", sum);
+
+	tar->size += TARBLKSZ;
+	memset(tar->buf + tar->size, 'x', size);
+	tar->size += (size + TARBLKSZ - 1) / TARBLKSZ * TARBLKSZ;
+	tar->entries++;
+}
+
+static void
+bench_tar_build(struct bench_tar *tar)
+{
+	char name[100], linkname[100];
+	int i;
+
+	/* The largest file is 7 blocks long, plus one for each header,
+	 * plus the end of archive blocks. */
+	tar->buf = m_malloc((size_t)(NENTRIES + 2) * TARBLKSZ * 8);
+	tar->size = 0;
+	tar->pos = 0;
+	tar->entries = 0;
+
+	for (i = 0; i < NENTRIES; i++) {
+		if (i % 20 == 0) {
+			sprintf(name, "./usr/share/dir-%d/", i / 20);
+			bench_tar_add(tar, tar_filetype_dir, name, NULL, 0);
+		} else if (i % 50 == 1) {
+			sprintf(name, "./usr/share/dir-%d/link-%d", i / 20, i);
+			sprintf(linkname, "file-%d", i - 1);
+			bench_tar_add(tar, tar_filetype_symlink, name, linkname, 0);
+		} else {
+			sprintf(name, "./usr/share/dir-%d/file-%d", i / 20, i);
+			bench_tar_add(tar, tar_filetype_file, name, NULL,
+			              (i % 8) * 400);
+		}
+	}
+
+	memset(tar->buf + tar->size, 0, TARBLKSZ * 2);
+	tar->size += TARBLKSZ * 2;
+}
+
+static int
+bench_tar_read(void *ctx, char *buf, int len)
+{
+	struct bench_tar *tar = ctx;
+
+	if (tar->pos + len > tar->size)
+		len = tar->size - tar->pos;
+	memcpy(buf, tar->buf + tar->pos, len);
+	tar->pos += len;
+
+	return len;
+}
+
+static int
+bench_tar_extract_file(void *ctx, struct tar_entry *h)
+{
+	struct bench_tar *tar = ctx;
+
+	tar->pos += (h->size + TARBLKSZ - 1) / TARBLKSZ * TARBLKSZ;
+
+	return 0;
+}
+
+static int
+bench_tar_entry(void *ctx, struct tar_entry *h)
+{
+	return 0;
+}
+
+static const struct tar_operations bench_tar_ops = {
+	.read = bench_tar_read,
+	.extract_file = bench_tar_extract_file,
+	.link = bench_tar_entry,
+	.symlink = bench_tar_entry,
+	.mkdir = bench_tar_entry,
+	.mknod = bench_tar_entry,
+};
+
+static void
+test(void)
+{
+	struct bench_tar tar;
+	double start;
+	int r;
+
+	bench_tar_build(&tar);
+
+	start = bench_time();
+	r = tar_extractor(&tar, &bench_tar_ops);
+	bench_report("tarfn", "tar_extractor", tar.entries, start);
+
+	test_pass(r == 0);
+
+	free(tar.buf);
+}
@@ -0,0 +1,108 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * b-version.c - benchmark version comparison
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/test.h>
+#include <dpkg/bench.h>
+#include <dpkg/dpkg-db.h>
+
+#define NVERSIONS 100000
+
+static struct versionrevision versions[NVERSIONS];
+
+static int
+version_cmp(const void *a, const void *b)
+{
+	return versioncompare(a, b);
+}
+
+/* Generate versions looking like the ones in a real archive, with a few
+ * components each, and some of the usual decorations. */
+static void
+bench_gen_versions(void)
+{
+	static const char *const decor[] = {
+		"", "", "", "~rc1", "+dfsg", "+b1", "~bpo50+1", "a", ".is.1",
+	};
+	char buf[64];
+	int i;
+
+	srand(1);
+
+	for (i = 0; i < NVERSIONS; i++) {
+		const char *emsg;
+
+		snprintf(buf, sizeof(buf), "%s%d.%d.%d%s-%d%s",
+		         rand() % 20 ? "" : "1:",
+		         rand() % 4, rand() % 30, rand() % 100,
+		         decor[rand() % (sizeof(decor) / sizeof(decor[0]))],
+		         rand() % 5, rand() % 3 ? "" : "ubuntu1");
+
+		emsg = parseversion(&versions[i], buf);
+		test_pass(emsg == NULL);
+	}
+}
+
+static void
+bench_sort(const char *name)
+{
+	static struct versionrevision sorted[NVERSIONS];
+	double start;
+
+	memcpy(sorted, versions, sizeof(versions));
+
+	start = bench_time();
+	qsort(sorted, NVERSIONS, sizeof(sorted[0]), version_cmp);
+	bench_report("version", name, NVERSIONS, start);
+}
+
+static void
+bench_compare(const char *name)
+{
+	double start;
+	int i, r = 0;
+
+	start = bench_time();
+	for (i = 1; i < NVERSIONS; i++)
+		r += versioncompare(&versions[i - 1], &versions[i]) < 0;
+	bench_report("version", name, NVERSIONS - 1, start);
+
+	test_pass(r > 0);
+}
+
+static void
+test(void)
+{
+	int i;
+
+	bench_gen_versions();
+	bench_compare("versioncompare-tokenized");
+	bench_sort("sort-tokenized");
+
+	for (i = 0; i < NVERSIONS; i++)
+		versions[i].version_key = versions[i].revision_key = NULL;
+	bench_compare("versioncompare-plain");
+	bench_sort("sort-plain");
+}
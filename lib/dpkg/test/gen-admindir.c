@@ -0,0 +1,375 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * gen-admindir.c - generate a synthetic admin directory for benchmarks
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/dpkg.h>
+#include <dpkg/varbuf.h>
+
+/*
+ * The generated admin directory has one installed package per requested
+ * package, each owning a directory with the requested number of files,
+ * plus a few files in directories shared with all the other packages.
+ * Packages depend on earlier ones, the lower numbered ones being the
+ * most depended on, as is the case with the libraries in a real system.
+ * Some of them divert files from others, have stat overrides, conffiles,
+ * or are interested in file or explicit triggers. The output only depends
+ * on the arguments, so that runs can be compared with each other.
+ *
+ * With --unpacked the packages are left waiting to be configured, and with
+ * --cycles=<n> each run of n consecutive packages is also made into a
+ * dependency cycle, each package depending on the next one and the last on
+ * the first, which together with the dependencies on earlier packages make
+ * for large strongly connected components.
+ */
+
+const char thisname[] = "gen-admindir";
+
+static const char *admindir;
+static int npackages = 2000;
+static int nfiles = 20;
+static bool unpacked = false;
+static int cycles = 0;
+
+static FILE *
+gen_open(const char *name)
+{
+	struct varbuf path = VARBUF_INIT;
+	FILE *file;
+
+	varbufprintf(&path, "%s/%s", admindir, name);
+	varbufaddc(&path, '\0');
+
+	file = fopen(path.buf, "w");
+	if (file == NULL)
+		ohshite("cannot create '%s'", path.buf);
+
+	varbuf_destroy(&path);
+
+	return file;
+}
+
+static void
+gen_close(FILE *file, const char *name)
+{
+	if (ferror(file) || fclose(file))
+		ohshite("cannot write '%s'", name);
+}
+
+static void
+gen_mkdir(const char *name)
+{
+	struct varbuf path = VARBUF_INIT;
+
+	varbufprintf(&path, "%s/%s", admindir, name);
+	varbufaddc(&path, '\0');
+
+	if (mkdir(path.buf, 0755) < 0 && errno != EEXIST)
+		ohshite("cannot create directory '%s'", path.buf);
+
+	varbuf_destroy(&path);
+}
+
+/* Pick a package earlier than pkg, favouring the first ones. */
+static int
+gen_dependee(int pkg)
+{
+	double r = rand() / (RAND_MAX + 1.0);
+
+	return r * r * pkg;
+}
+
+static void
+gen_version(struct varbuf *vb, int pkg)
+{
+	static const char *const decor[] = {
+		"", "", "", "~rc1", "+dfsg", "+b1", "a",
+	};
+
+	varbufprintf(vb, "%s%d.%d.%d%s-%d",
+	             pkg % 20 ? "" : "1:",
+	             pkg % 4, pkg % 30, pkg % 100,
+	             decor[pkg % (sizeof(decor) / sizeof(decor[0]))],
+	             pkg % 5 + 1);
+}
+
+/* The package following pkg in its dependency cycle, or -1 if none. */
+static int
+gen_cycle_next(int pkg)
+{
+	if (cycles < 2)
+		return -1;
+	if (pkg % cycles == cycles - 1 || pkg == npackages - 1)
+		return pkg - pkg % cycles;
+
+	return pkg + 1;
+}
+
+static void
+gen_depends(struct varbuf *vb, const char *field, int pkg, int max,
+            int next)
+{
+	int i, n;
+
+	n = pkg == 0 ? 0 : rand() % (max + 1);
+	if (n == 0 && next < 0)
+		return;
+
+	varbufprintf(vb, "%s: ", field);
+	for (i = 0; i < n; i++) {
+		int dep = gen_dependee(pkg);
+
+		if (i)
+			varbufaddstr(vb, ", ");
+		varbufprintf(vb, "pkg-%d", dep);
+		if (rand() % 3 == 0) {
+			varbufaddstr(vb, " (>= ");
+			gen_version(vb, dep);
+			varbufaddc(vb, ')');
+		}
+		if (rand() % 8 == 0)
+			varbufprintf(vb, " | pkg-%d", gen_dependee(pkg));
+	}
+	if (next >= 0)
+		varbufprintf(vb, "%spkg-%d", n ? ", " : "", next);
+	varbufaddc(vb, '\n');
+}
+
+static void
+gen_record(struct varbuf *vb, int pkg, bool status)
+{
+	varbufprintf(vb, "Package: pkg-%d\n", pkg);
+	if (status)
+		varbufprintf(vb, "Status: install ok %s\n",
+		             unpacked ? "unpacked" : "installed");
+	varbufprintf(vb, "Priority: %s\n", pkg % 7 ? "optional" : "required");
+	varbufprintf(vb, "Section: section-%d\n", pkg % 12);
+	varbufprintf(vb, "Installed-Size: %d\n", (pkg % 97) * 13 + nfiles);
+	varbufprintf(vb, "Maintainer: Maintainer %d <maint-%d@example.org>\n",
+	             pkg % 300, pkg % 300);
+	varbufaddstr(vb, "Architecture: all\n");
+	varbufaddstr(vb, "Version: ");
+	gen_version(vb, pkg);
+	varbufaddc(vb, '\n');
+	if (pkg % 11 == 0)
+		varbufprintf(vb, "Provides: virt-%d\n", pkg % 50);
+	gen_depends(vb, "Pre-Depends", pkg, pkg % 13 ? 0 : 1, -1);
+	gen_depends(vb, "Depends", pkg, 5, gen_cycle_next(pkg));
+	gen_depends(vb, "Recommends", pkg, 2, -1);
+	if (pkg % 17 == 0)
+		varbufprintf(vb, "Conflicts: old-pkg-%d\n", pkg);
+	if (pkg % 10 == 0 && status)
+		varbufprintf(vb, "Conffiles:\n /etc/pkg-%d.conf "
+		             "0123456789abcdef0123456789abcdef\n", pkg);
+	if (!status)
+		varbufprintf(vb, "Filename: pool/pkg-%d_all.deb\n"
+		             "Size: %d\n", pkg, (pkg % 97) * 4096 + 1024);
+	varbufprintf(vb, "Description: synthetic package %d\n"
+	             " This package has been generated to exercise the\n"
+	             " package database code with a large admin directory.\n",
+	             pkg);
+	varbufaddc(vb, '\n');
+}
+
+static void
+gen_db(const char *name, bool status)
+{
+	struct varbuf vb = VARBUF_INIT;
+	FILE *file;
+	int i;
+
+	srand(1);
+
+	file = gen_open(name);
+	for (i = 0; i < npackages; i++) {
+		varbufreset(&vb);
+		gen_record(&vb, i, status);
+		fwrite(vb.buf, vb.used, 1, file);
+	}
+	gen_close(file, name);
+
+	varbuf_destroy(&vb);
+}
+
+static void
+gen_lists(void)
+{
+	struct varbuf name = VARBUF_INIT;
+	int i, j;
+
+	for (i = 0; i < npackages; i++) {
+		FILE *file;
+
+		varbufreset(&name);
+		varbufprintf(&name, INFODIR "pkg-%d.list", i);
+		varbufaddc(&name, '\0');
+
+		file = gen_open(name.buf);
+		fputs("/.\n/usr\n/usr/bin\n/usr/share\n/usr/share/doc\n", file);
+		fprintf(file, "/usr/bin/pkg-%d\n", i);
+		fprintf(file, "/usr/share/doc/pkg-%d\n", i);
+		fprintf(file, "/usr/share/doc/pkg-%d/copyright\n", i);
+		fprintf(file, "/usr/share/pkg-%d\n", i);
+		for (j = 0; j < nfiles; j++)
+			fprintf(file, "/usr/share/pkg-%d/file-%d\n", i, j);
+		if (i % 10 == 0)
+			fprintf(file, "/etc\n/etc/pkg-%d.conf\n", i);
+		gen_close(file, name.buf);
+	}
+
+	varbuf_destroy(&name);
+}
+
+static void
+gen_diversions(void)
+{
+	FILE *file;
+	int i;
+
+	file = gen_open(DIVERSIONSFILE);
+	for (i = 25; i < npackages; i += 25)
+		fprintf(file, "/usr/bin/pkg-%d\n/usr/bin/pkg-%d.distrib\npkg-%d\n",
+		        i - 1, i - 1, i);
+	gen_close(file, DIVERSIONSFILE);
+}
+
+static void
+gen_statoverrides(void)
+{
+	FILE *file;
+	int i;
+
+	file = gen_open(STATOVERRIDEFILE);
+	for (i = 0; i < npackages; i += 10)
+		fprintf(file, "root root 0755 /usr/share/pkg-%d/file-0\n", i);
+	gen_close(file, STATOVERRIDEFILE);
+}
+
+static void
+gen_triggers(void)
+{
+	struct varbuf name = VARBUF_INIT;
+	FILE *filetrig, *file;
+	int i;
+
+	gen_mkdir(TRIGGERSDIR);
+
+	file = gen_open(TRIGGERSDIR TRIGGERSDEFERREDFILE);
+	gen_close(file, TRIGGERSDEFERREDFILE);
+
+	filetrig = gen_open(TRIGGERSDIR TRIGGERSFILEFILE);
+	for (i = 0; i < npackages; i += 40) {
+		varbufreset(&name);
+		varbufprintf(&name, INFODIR "pkg-%d.triggers", i);
+		varbufaddc(&name, '\0');
+
+		file = gen_open(name.buf);
+		fprintf(file, "interest /usr/share/pkg-%d\n", i);
+		fprintf(filetrig, "/usr/share/pkg-%d pkg-%d\n", i, i);
+		if (i % 200 == 0)
+			fprintf(file, "interest trigger-%d\n", i);
+		gen_close(file, name.buf);
+
+		if (i % 200)
+			continue;
+
+		varbufreset(&name);
+		varbufprintf(&name, TRIGGERSDIR "trigger-%d", i);
+		varbufaddc(&name, '\0');
+
+		file = gen_open(name.buf);
+		fprintf(file, "pkg-%d\n", i);
+		gen_close(file, name.buf);
+	}
+	gen_close(filetrig, TRIGGERSFILEFILE);
+
+	varbuf_destroy(&name);
+}
+
+static int
+gen_arg(const char *arg)
+{
+	char *end;
+	long v;
+
+	v = strtol(arg, &end, 10);
+	if (*arg == '\0' || *end || v < 1 || v > 1000000)
+		ohshit("invalid number '%s'", arg);
+
+	return v;
+}
+
+int
+main(int argc, char **argv)
+{
+	jmp_buf ejbuf;
+
+	if (setjmp(ejbuf)) {
+		error_unwind(ehflag_bombout);
+		return 2;
+	}
+	push_error_handler(&ejbuf, print_error_fatal, NULL);
+
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+		if (strcmp(argv[1], "--unpacked") == 0)
+			unpacked = true;
+		else if (strncmp(argv[1], "--cycles=", 9) == 0)
+			cycles = gen_arg(argv[1] + 9);
+		else
+			ohshit("unknown option '%s'", argv[1]);
+		argc--;
+		argv++;
+	}
+
+	if (argc < 2 || argc > 4)
+		ohshit("usage: %s [--unpacked] [--cycles=<n>] <admindir> "
+		       "[<packages> [<files-per-package>]]", thisname);
+
+	admindir = argv[1];
+	if (argc > 2)
+		npackages = gen_arg(argv[2]);
+	if (argc > 3)
+		nfiles = gen_arg(argv[3]);
+
+	gen_mkdir("");
+	gen_mkdir(INFODIR);
+	gen_mkdir(UPDATESDIR);
+
+	gen_db(STATUSFILE, true);
+	gen_db(AVAILFILE, false);
+	gen_lists();
+	gen_diversions();
+	gen_statoverrides();
+	gen_triggers();
+
+	set_error_display(NULL, NULL);
+	error_unwind(ehflag_normaltidy);
+
+	return 0;
+}
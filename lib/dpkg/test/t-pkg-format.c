@@ -0,0 +1,84 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * t-pkg-format.c - test package format handling
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <dpkg/test.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/pkg-format.h>
+
+static void
+test_pkg_format_print(const char *fmt, struct pkginfo *pkg, const char *out)
+{
+	struct pkg_format_node *head;
+	struct varbuf vb = VARBUF_INIT;
+
+	head = pkg_format_parse(fmt);
+	test_pass(head != NULL);
+
+	pkg_format_print(&vb, head, pkg, &pkg->installed);
+	varbufaddc(&vb, '\0');
+	test_str(vb.buf, ==, out);
+
+	varbuf_destroy(&vb);
+	pkg_format_free(head);
+}
+
+static void
+test_pkg_format(void)
+{
+	struct pkginfo pkg;
+	struct arbitraryfield arb;
+
+	blankpackage(&pkg);
+	pkg.name = "test";
+	pkg.installed.version.version = "1.0";
+	pkg.installed.version.revision = "2";
+
+	arb.next = NULL;
+	arb.name = "X-Extra";
+	arb.value = "extra value";
+	pkg.installed.arbs = &arb;
+
+	test_pkg_format_print("${Package}\\n", &pkg, "test\n");
+	test_pkg_format_print("${package} ${VERSION}", &pkg, "test 1.0-2");
+
+	/* Field widths pad, and truncate longer values. */
+	test_pkg_format_print("[${Package;6}]", &pkg, "[  test]");
+	test_pkg_format_print("[${Package;-6}]", &pkg, "[test  ]");
+	test_pkg_format_print("[${Package;2}]", &pkg, "[te]");
+	test_pkg_format_print("[${Package;-2}]", &pkg, "[te]");
+
+	/* Arbitrary fields are looked up by name. */
+	test_pkg_format_print("${x-extra;-12}|", &pkg, "extra value |");
+
+	/* Unknown fields produce no output, not even padding. */
+	test_pkg_format_print("a${X-Unknown;4}b", &pkg, "ab");
+
+	test_pkg_format_print("\\ta\\\\b", &pkg, "\ta\\b");
+}
+
+static void
+test(void)
+{
+	test_pkg_format();
+}
@@ -0,0 +1,91 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * t-ugid.c - test cached user and group database lookups
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+
+#include <string.h>
+#include <pwd.h>
+#include <grp.h>
+
+#include <dpkg/test.h>
+#include <dpkg/ugid.h>
+
+/* A name which cannot exist, as it contains a colon. */
+#define UGID_BOGUS "dpkg:bogus"
+
+static void
+test_ugid_user(void)
+{
+	struct passwd *pw;
+	uid_t uid;
+	int i;
+
+	pw = getpwuid(0);
+	test_fail(pw == NULL);
+
+	/* Run twice, to go through both the lookup and the cache. */
+	for (i = 0; i < 2; i++) {
+		uid = 42;
+		test_pass(ugid_user_id(pw->pw_name, &uid));
+		test_pass(uid == 0);
+		test_str(ugid_user_name(0), ==, pw->pw_name);
+
+		uid = 42;
+		test_fail(ugid_user_id(UGID_BOGUS, &uid));
+		test_pass(uid == 42);
+	}
+}
+
+static void
+test_ugid_group(void)
+{
+	struct group *gr;
+	gid_t gid;
+	int i;
+
+	gr = getgrgid(0);
+	test_fail(gr == NULL);
+
+	for (i = 0; i < 2; i++) {
+		gid = 42;
+		test_pass(ugid_group_id(gr->gr_name, &gid));
+		test_pass(gid == 0);
+		test_str(ugid_group_name(0), ==, gr->gr_name);
+
+		gid = 42;
+		test_fail(ugid_group_id(UGID_BOGUS, &gid));
+		test_pass(gid == 42);
+	}
+}
+
+static void
+test(void)
+{
+	test_ugid_user();
+	test_ugid_group();
+
+	ugid_cache_flush();
+
+	test_ugid_user();
+	test_ugid_group();
+}
@@ -21,6 +21,8 @@
 #include <config.h>
 #include <compat.h>
 
+#include <stdlib.h>
+
 #include <dpkg/test.h>
 #include <dpkg/dpkg-db.h>
 
@@ -146,10 +148,126 @@ test_version_parse(void)
 	/* FIXME: Complete. */
 }
 
+static void
+test_version_satisfied(void)
+{
+	struct pkginfoperfile it;
+	struct deppossi dep;
+
+	dep.version = version(0, "1.0", "1");
+	dep.verrel = dvr_laterequal;
+	dep.cache.valid = false;
+
+	it.version = version(0, "1.0", "2");
+	test_pass(versionsatisfied(&it, &dep));
+	test_pass(dep.cache.valid);
+	test_pass(versionsatisfied(&it, &dep));
+
+	/* A different version must not reuse the cached result. */
+	it.version = version(0, "0.9", "1");
+	test_fail(versionsatisfied(&it, &dep));
+	it.version.epoch = 1;
+	test_pass(versionsatisfied(&it, &dep));
+
+	dep.verrel = dvr_none;
+	it.version = version(0, "0.1", "");
+	test_pass(versionsatisfied(&it, &dep));
+}
+
+static int
+sign(int r)
+{
+	return r < 0 ? -1 : r > 0;
+}
+
+/* Compare both with and without the pre-tokenized keys, which must give
+ * the same result. */
+static int
+test_compare_tokenized(const char *a_str, const char *b_str)
+{
+	struct versionrevision a, b, a_key, b_key;
+	int r;
+
+	a = a_key = version(0, a_str, "");
+	b = b_key = version(0, b_str, "");
+	tokenizeversion(&a_key);
+	tokenizeversion(&b_key);
+
+	r = sign(versioncompare(&a, &b));
+	test_pass(sign(versioncompare(&a_key, &b_key)) == r);
+	test_pass(sign(versioncompare(&b_key, &a_key)) == -r);
+
+	return r;
+}
+
+static void
+test_version_tokenized(void)
+{
+	struct versionrevision a;
+
+	test_pass(test_compare_tokenized("", "0") == 0);
+	test_pass(test_compare_tokenized("1.0", "1.00") == 0);
+	test_pass(test_compare_tokenized("1.0", "1.0.0") < 0);
+	test_pass(test_compare_tokenized("1.0~rc1", "1.0") < 0);
+	test_pass(test_compare_tokenized("1.0~", "1.0~~") > 0);
+	test_pass(test_compare_tokenized("1.0", "1.0a") < 0);
+	test_pass(test_compare_tokenized("1.0a", "1.0+") < 0);
+	test_pass(test_compare_tokenized("1.0+", "1.0.") < 0);
+	test_pass(test_compare_tokenized("1:2", "1.2") > 0);
+	test_pass(test_compare_tokenized("0.1", ".1") < 0);
+	test_pass(test_compare_tokenized("9", "10") < 0);
+	test_pass(test_compare_tokenized("007", "7") == 0);
+
+	/* Strings we cannot tokenize fall back to the plain comparison. */
+	a = version(0, "1!0", "");
+	tokenizeversion(&a);
+	test_pass(a.version_key == NULL);
+	test_pass(a.revision_key != NULL);
+
+	/* Check that parseversion() fills in the keys. */
+	test_pass(parseversion(&a, "1:2.0-3") == NULL);
+	test_pass(a.version_key != NULL);
+	test_pass(a.revision_key != NULL);
+	test_fail(parseversion(&a, "1:2.0-!") == NULL);
+	test_pass(a.version_key == NULL);
+}
+
+/* Compare lots of random versions, made of the characters and runs which
+ * matter to the comparison, with and without keys. */
+static void
+test_version_tokenized_fuzz(void)
+{
+	static const char chars[] = "0000123456789~~..++--::aAzZ";
+	char a[16], b[16];
+	int i, j, len;
+
+	srand(42);
+
+	for (i = 0; i < 200000; i++) {
+		len = rand() % (sizeof(a) - 1);
+		for (j = 0; j < len; j++)
+			a[j] = chars[rand() % (sizeof(chars) - 1)];
+		a[len] = '\0';
+
+		/* Make b share a prefix with a, so that the comparison does
+		 * not always get decided on the first character. */
+		len = rand() % (sizeof(b) - 1);
+		for (j = 0; j < len; j++)
+			b[j] = (j < len / 2 && a[j]) ? a[j] :
+			       chars[rand() % (sizeof(chars) - 1)];
+		b[len] = '\0';
+
+		test_compare_tokenized(a, b);
+	}
+}
+
 static void
 test(void)
 {
 	test_version_compare();
 	test_version_parse();
+	test_version_satisfied();
+	test_version_tokenized();
+	test_version_tokenized_fuzz();
 }
 
@@ -0,0 +1,202 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * timing.c - phase timers and system call counters
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/timing.h>
+
+/*
+ * The timers are only run once enabled, so that they cost nothing more
+ * than a test otherwise. A phase is not expected to be entered again
+ * before it has been left; if it is left through an error, the time spent
+ * in it until then is just not accounted for. The counters are always
+ * updated, as they are cheaper than the system calls they count.
+ */
+
+static const char *const timing_phase_names[] = {
+	[timing_parsedb] = "parsedb",
+	[timing_writedb] = "writedb",
+	[timing_modstatdb_note] = "modstatdb_note",
+	[timing_filesdb_load] = "ensure_allinstfiles_available",
+	[timing_tar_extract] = "tar_extractor",
+	[timing_tar_deferred_extract] = "tar_deferred_extract",
+	[timing_maintscript] = "maintainer_script",
+	[timing_trigproc] = "trigproc",
+	[timing_order_queue] = "order_queue",
+};
+
+static const char *const timing_counter_names[] = {
+	[timing_fsync] = "fsync",
+	[timing_rename] = "rename",
+	[timing_lstat] = "lstat",
+	[timing_dependencies_ok] = "dependencies_ok",
+};
+
+static bool timing_enabled;
+static struct timespec timing_epoch;
+
+static struct {
+	unsigned long calls;
+	struct timespec start;
+	double seconds;
+} timing_phases[timing_phase_count];
+
+static unsigned long timing_counters[timing_counter_count];
+
+/* Peak resident set size of the process so far, in KiB. */
+static long
+timing_maxrss(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) < 0)
+		return 0;
+
+	return ru.ru_maxrss;
+}
+
+static void
+timing_now(struct timespec *ts)
+{
+	if (clock_gettime(CLOCK_MONOTONIC, ts) < 0)
+		ohshite(_("unable to get the current time"));
+}
+
+static double
+timing_since(const struct timespec *start)
+{
+	struct timespec now;
+
+	timing_now(&now);
+
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void
+timing_enable(void)
+{
+	timing_enabled = true;
+	timing_now(&timing_epoch);
+}
+
+void
+timing_start(enum timing_phase phase)
+{
+	if (!timing_enabled)
+		return;
+
+	timing_phases[phase].calls++;
+	timing_now(&timing_phases[phase].start);
+}
+
+void
+timing_stop(enum timing_phase phase)
+{
+	if (!timing_enabled)
+		return;
+
+	timing_phases[phase].seconds += timing_since(&timing_phases[phase].start);
+}
+
+/**
+ * Account for a phase run measured by the caller.
+ *
+ * This is for runs which cannot be bracketed by timing_start() and
+ * timing_stop() because they overlap, such as concurrent maintainer
+ * scripts, whose times just add up.
+ */
+void
+timing_add(enum timing_phase phase, double seconds)
+{
+	if (!timing_enabled)
+		return;
+
+	timing_phases[phase].calls++;
+	timing_phases[phase].seconds += seconds;
+}
+
+void
+timing_count(enum timing_counter counter)
+{
+	timing_counters[counter]++;
+}
+
+void
+timing_report(FILE *file)
+{
+	int i;
+
+	fprintf(file, "timing total: %.6f seconds, %ld KiB peak RSS\n",
+	        timing_since(&timing_epoch), timing_maxrss());
+
+	for (i = 0; i < timing_phase_count; i++) {
+		if (!timing_phases[i].calls)
+			continue;
+
+		fprintf(file, "timing %s: %lu calls, %.6f seconds\n",
+		        timing_phase_names[i], timing_phases[i].calls,
+		        timing_phases[i].seconds);
+	}
+
+	for (i = 0; i < timing_counter_count; i++)
+		fprintf(file, "timing %s: %lu calls\n",
+		        timing_counter_names[i], timing_counters[i]);
+}
+
+/**
+ * Write the timers and counters as a single JSON object line.
+ *
+ * The program and action names are printed as is, so they must not
+ * contain anything that would need quoting.
+ */
+void
+timing_report_json(FILE *file, const char *program, const char *action)
+{
+	int i;
+
+	fprintf(file, "{\"program\":\"%s\",\"action\":\"%s\",\"pid\":%ld,"
+	        "\"seconds\":%.6f,\"maxrss_kb\":%ld,\"phases\":{",
+	        program, action, (long)getpid(), timing_since(&timing_epoch),
+	        timing_maxrss());
+
+	for (i = 0; i < timing_phase_count; i++)
+		fprintf(file, "%s\"%s\":{\"calls\":%lu,\"seconds\":%.6f}",
+		        i ? "," : "", timing_phase_names[i],
+		        timing_phases[i].calls, timing_phases[i].seconds);
+
+	fputs("},\"counters\":{", file);
+
+	for (i = 0; i < timing_counter_count; i++)
+		fprintf(file, "%s\"%s\":%lu", i ? "," : "",
+		        timing_counter_names[i], timing_counters[i]);
+
+	fputs("}}\n", file);
+}
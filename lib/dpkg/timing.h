@@ -0,0 +1,64 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * timing.h - phase timers and system call counters
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBDPKG_TIMING_H
+#define LIBDPKG_TIMING_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <dpkg/macros.h>
+
+DPKG_BEGIN_DECLS
+
+enum timing_phase {
+	timing_parsedb,
+	timing_writedb,
+	timing_modstatdb_note,
+	timing_filesdb_load,
+	timing_tar_extract,
+	timing_tar_deferred_extract,
+	timing_maintscript,
+	timing_trigproc,
+	timing_order_queue,
+	timing_phase_count,
+};
+
+enum timing_counter {
+	timing_fsync,
+	timing_rename,
+	timing_lstat,
+	timing_dependencies_ok,
+	timing_counter_count,
+};
+
+void timing_enable(void);
+
+void timing_start(enum timing_phase phase);
+void timing_stop(enum timing_phase phase);
+void timing_add(enum timing_phase phase, double seconds);
+void timing_count(enum timing_counter counter);
+
+void timing_report(FILE *file);
+void timing_report_json(FILE *file, const char *program, const char *action);
+
+DPKG_END_DECLS
+
+#endif /* LIBDPKG_TIMING_H */
@@ -38,6 +38,7 @@
 #include <dpkg/dir.h>
 #include <dpkg/trigdeferred.h>
 #include <dpkg/triglib.h>
+#include <dpkg/timing.h>
 
 const char *
 illegal_triggername(const char *p)
@@ -112,7 +113,7 @@ trig_record_activation(struct pkginfo *pend, struct pkginfo *aw, const char *tri
 		modstatdb_note_ifwrite(pend);
 
 	if (trigh.enqueue_deferred)
-		trigh.enqueue_deferred(pend);
+		trigh.enqueue_deferred(pend, trig);
 
 	if (aw && pend->status > stat_configfiles)
 		if (trig_note_aw(pend, aw)) {
@@ -128,8 +129,10 @@ trig_note_pend_core(struct pkginfo *pend, const char *trig /*not copied!*/)
 {
 	struct trigpend *tp;
 
+	/* File trigger names are the interned filenamenode names, so when
+	 * the same file activates the trigger again the pointers match. */
 	for (tp = pend->trigpend_head; tp; tp = tp->next)
-		if (!strcmp(tp->name, trig))
+		if (tp->name == trig || !strcmp(tp->name, trig))
 			return false;
 
 	tp = nfmalloc(sizeof(*tp));
@@ -427,6 +430,7 @@ trk_explicit_interest_change(const char *trig,  struct pkginfo *pkg, int signum)
 	if (fflush(nf))
 		ohshite(_("unable to flush new trigger interest file '%.250s'"),
 		        newfn.buf);
+	timing_count(timing_fsync);
 	if (fsync(fileno(nf)))
 		ohshite(_("unable to sync new trigger interest file '%.250s'"),
 		        newfn.buf);
@@ -435,6 +439,7 @@ trk_explicit_interest_change(const char *trig,  struct pkginfo *pkg, int signum)
 		ohshite(_("unable to close new trigger interest file `%.250s'"),
 		        newfn.buf);
 
+	timing_count(timing_rename);
 	if (rename(newfn.buf, trk_explicit_fn.buf))
 		ohshite(_("unable to install new trigger interest file `%.250s'"),
 		        trk_explicit_fn.buf);
@@ -537,6 +542,7 @@ trig_file_interests_save(void)
 	if (fflush(nf))
 		ohshite(_("unable to flush new file triggers file '%.250s'"),
 		        triggersnewfilefile);
+	timing_count(timing_fsync);
 	if (fsync(fileno(nf)))
 		ohshite(_("unable to sync new file triggers file '%.250s'"),
 		        triggersnewfilefile);
@@ -545,6 +551,7 @@ trig_file_interests_save(void)
 		ohshite(_("unable to close new file triggers file `%.250s'"),
 		        triggersnewfilefile);
 
+	timing_count(timing_rename);
 	if (rename(triggersnewfilefile, triggersfilefile))
 		ohshite(_("unable to install new file triggers file as `%.250s'"),
 		        triggersfilefile);
@@ -603,6 +610,13 @@ trig_file_activate_byname(const char *trig, struct pkginfo *aw)
 		trig_file_activate(fnn, aw);
 }
 
+/*
+ * The interests are hung off the filenamenode itself when the File list
+ * is loaded, so the files being unpacked or removed, which already have
+ * their node at hand, only pay for a pointer check here. Directory
+ * interests are matched through the entries for the directories, which
+ * are part of the file lists of the packages shipping files under them.
+ */
 void
 trig_file_activate(struct filenamenode *trig, struct pkginfo *aw)
 {
@@ -51,7 +51,8 @@ struct trigfileint {
  * If non-NULL, we're dpkg proper and we might need to invent trigger
  * activations as the first run of a triggers-supporting dpkg. */
 struct trig_hooks {
-	void (*enqueue_deferred)(struct pkginfo *pend);
+	/* Called for every activation of trig recorded against pend. */
+	void (*enqueue_deferred)(struct pkginfo *pend, const char *trig);
 	void (*transitional_activate)(enum modstatdb_rw cstatus);
 
 	struct filenamenode *(*namenode_find)(const char *filename, bool nonew);
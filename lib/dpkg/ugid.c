@@ -0,0 +1,249 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * ugid.c - cached user and group database lookups
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+
+#include <string.h>
+#include <stdlib.h>
+#include <pwd.h>
+#include <grp.h>
+
+#include <dpkg/dpkg.h>
+#include <dpkg/ugid.h>
+
+/*
+ * The user and group databases might be served by a network backend, where
+ * each lookup can cost a round-trip, and archives and statoverride files
+ * tend to use the same few names over and over. So we remember the result
+ * of every lookup, including the failed ones, until ugid_cache_flush() is
+ * called, which needs to be done whenever the databases might have been
+ * changed, for example after running a maintainer script.
+ */
+
+enum ugid_kind {
+	ugid_user_byname,
+	ugid_group_byname,
+	ugid_user_byid,
+	ugid_group_byid,
+	ugid_kind_count,
+};
+
+struct ugid_entry {
+	struct ugid_entry *next;
+	enum ugid_kind kind;
+	/* The name is NULL for a failed lookup by id. */
+	char *name;
+	unsigned long id;
+	bool found;
+};
+
+#define UGID_BINS 64
+
+static struct ugid_entry *ugid_bins[UGID_BINS];
+
+static const char *const ugid_kind_names[] = {
+	[ugid_user_byname] = "user names",
+	[ugid_group_byname] = "group names",
+	[ugid_user_byid] = "user ids",
+	[ugid_group_byid] = "group ids",
+};
+
+static struct {
+	unsigned long lookups;
+	unsigned long hits;
+} ugid_stats[ugid_kind_count];
+
+static unsigned int
+ugid_hash_name(enum ugid_kind kind, const char *name)
+{
+	unsigned int h = kind;
+
+	while (*name)
+		h = h * 31 + (unsigned char)*name++;
+
+	return h % UGID_BINS;
+}
+
+static unsigned int
+ugid_hash_id(enum ugid_kind kind, unsigned long id)
+{
+	return (id * 31 + kind) % UGID_BINS;
+}
+
+static struct ugid_entry *
+ugid_find_name(enum ugid_kind kind, const char *name)
+{
+	struct ugid_entry *entry;
+
+	ugid_stats[kind].lookups++;
+
+	for (entry = ugid_bins[ugid_hash_name(kind, name)]; entry;
+	     entry = entry->next)
+		if (entry->kind == kind && strcmp(entry->name, name) == 0) {
+			ugid_stats[kind].hits++;
+			return entry;
+		}
+
+	return NULL;
+}
+
+static struct ugid_entry *
+ugid_find_id(enum ugid_kind kind, unsigned long id)
+{
+	struct ugid_entry *entry;
+
+	ugid_stats[kind].lookups++;
+
+	for (entry = ugid_bins[ugid_hash_id(kind, id)]; entry;
+	     entry = entry->next)
+		if (entry->kind == kind && entry->id == id) {
+			ugid_stats[kind].hits++;
+			return entry;
+		}
+
+	return NULL;
+}
+
+static struct ugid_entry *
+ugid_add(unsigned int bin, enum ugid_kind kind, const char *name,
+         unsigned long id, bool found)
+{
+	struct ugid_entry *entry;
+
+	entry = m_malloc(sizeof(*entry));
+	entry->kind = kind;
+	entry->name = name ? m_strdup(name) : NULL;
+	entry->id = id;
+	entry->found = found;
+	entry->next = ugid_bins[bin];
+	ugid_bins[bin] = entry;
+
+	return entry;
+}
+
+bool
+ugid_user_id(const char *name, uid_t *uid)
+{
+	struct ugid_entry *entry;
+
+	entry = ugid_find_name(ugid_user_byname, name);
+	if (entry == NULL) {
+		struct passwd *pw = getpwnam(name);
+
+		entry = ugid_add(ugid_hash_name(ugid_user_byname, name),
+		                 ugid_user_byname, name,
+		                 pw ? pw->pw_uid : 0, pw != NULL);
+	}
+
+	if (entry->found)
+		*uid = entry->id;
+
+	return entry->found;
+}
+
+bool
+ugid_group_id(const char *name, gid_t *gid)
+{
+	struct ugid_entry *entry;
+
+	entry = ugid_find_name(ugid_group_byname, name);
+	if (entry == NULL) {
+		struct group *gr = getgrnam(name);
+
+		entry = ugid_add(ugid_hash_name(ugid_group_byname, name),
+		                 ugid_group_byname, name,
+		                 gr ? gr->gr_gid : 0, gr != NULL);
+	}
+
+	if (entry->found)
+		*gid = entry->id;
+
+	return entry->found;
+}
+
+const char *
+ugid_user_name(uid_t uid)
+{
+	struct ugid_entry *entry;
+
+	entry = ugid_find_id(ugid_user_byid, uid);
+	if (entry == NULL) {
+		struct passwd *pw = getpwuid(uid);
+
+		entry = ugid_add(ugid_hash_id(ugid_user_byid, uid),
+		                 ugid_user_byid, pw ? pw->pw_name : NULL,
+		                 uid, pw != NULL);
+	}
+
+	return entry->name;
+}
+
+const char *
+ugid_group_name(gid_t gid)
+{
+	struct ugid_entry *entry;
+
+	entry = ugid_find_id(ugid_group_byid, gid);
+	if (entry == NULL) {
+		struct group *gr = getgrgid(gid);
+
+		entry = ugid_add(ugid_hash_id(ugid_group_byid, gid),
+		                 ugid_group_byid, gr ? gr->gr_name : NULL,
+		                 gid, gr != NULL);
+	}
+
+	return entry->name;
+}
+
+/**
+ * Forget all the cached lookups.
+ */
+void
+ugid_cache_flush(void)
+{
+	struct ugid_entry *entry;
+	int i;
+
+	for (i = 0; i < UGID_BINS; i++) {
+		while ((entry = ugid_bins[i])) {
+			ugid_bins[i] = entry->next;
+			free(entry->name);
+			free(entry);
+		}
+	}
+}
+
+void
+ugid_cache_report(FILE *file)
+{
+	int i;
+
+	for (i = 0; i < ugid_kind_count; i++) {
+		if (!ugid_stats[i].lookups)
+			continue;
+
+		fprintf(file, "ugid cache %s: %lu lookups, %lu hits\n",
+		        ugid_kind_names[i], ugid_stats[i].lookups,
+		        ugid_stats[i].hits);
+	}
+}
@@ -0,0 +1,43 @@
+/*
+ * libdpkg - Debian packaging suite library routines
+ * ugid.h - cached user and group database lookups
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBDPKG_UGID_H
+#define LIBDPKG_UGID_H
+
+#include <sys/types.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <dpkg/macros.h>
+
+DPKG_BEGIN_DECLS
+
+bool ugid_user_id(const char *name, uid_t *uid);
+bool ugid_group_id(const char *name, gid_t *gid);
+const char *ugid_user_name(uid_t uid);
+const char *ugid_group_name(gid_t gid);
+
+void ugid_cache_flush(void);
+void ugid_cache_report(FILE *file);
+
+DPKG_END_DECLS
+
+#endif /* LIBDPKG_UGID_H */
@@ -68,14 +68,148 @@ static int verrevcmp(const char *val, const char *ref) {
   return 0;
 }
 
+/*
+ * A version key is the version or revision string rewritten so that
+ * comparing two keys with memcmp() gives the same result as verrevcmp()
+ * on the strings. Each run of non-digits followed by a run of digits
+ * gets encoded as:
+ *
+ *   - the non-digits, mapped to bytes with the same ordering as order(),
+ *     that is '~' < end of run < letters < other characters,
+ *   - VERKEY_RUN_END, standing for the end of the run,
+ *   - the number of digits after skipping the leading zeros, so that
+ *     longer numbers sort later, followed by those digits.
+ *
+ * A string which ends early compares as if it went on with empty runs
+ * of non-digits followed by zeros, which verkey_tail() deals with.
+ */
+struct versionkey {
+  size_t len;
+  unsigned char data[];
+};
+
+#define VERKEY_TILDE 1
+#define VERKEY_RUN_END 2
+#define VERKEY_DIGITS_MAX 255
+
+static int
+verkey_weight(int c)
+{
+  if (c == '~')
+    return VERKEY_TILDE;
+  if (cisalpha(c))
+    return c;
+  switch (c) {
+  case '+': return 'z' + 1;
+  case '-': return 'z' + 2;
+  case '.': return 'z' + 3;
+  case ':': return 'z' + 4;
+  default: return -1;
+  }
+}
+
+static const struct versionkey *
+verkey_new(const char *str)
+{
+  static struct varbuf vb;
+  struct versionkey *key;
+
+  varbufreset(&vb);
+
+  while (*str) {
+    const char *digits;
+    size_t len;
+
+    while (*str && !cisdigit(*str)) {
+      int weight = verkey_weight(*str++);
+
+      /* Leave strings with characters we cannot map to verrevcmp(). */
+      if (weight < 0)
+        return NULL;
+      varbufaddc(&vb, weight);
+    }
+    varbufaddc(&vb, VERKEY_RUN_END);
+
+    while (*str == '0')
+      str++;
+    digits = str;
+    while (cisdigit(*str))
+      str++;
+    len = str - digits;
+    if (len > VERKEY_DIGITS_MAX)
+      return NULL;
+    varbufaddc(&vb, len);
+    varbufaddbuf(&vb, digits, len);
+  }
+
+  key = nfmalloc(sizeof(*key) + vb.used);
+  key->len = vb.used;
+  memcpy(key->data, vb.buf, vb.used);
+
+  return key;
+}
+
+void
+tokenizeversion(struct versionrevision *version)
+{
+  version->version_key = verkey_new(version->version ?
+                                    version->version : "");
+  version->revision_key = verkey_new(version->revision ?
+                                     version->revision : "");
+}
+
+/* Compare the rest of a key, starting at a run boundary, against the
+ * empty runs an ended string stands for. */
+static int
+verkey_tail(const unsigned char *data, size_t len)
+{
+  while (len) {
+    if (data[0] != VERKEY_RUN_END)
+      return data[0] < VERKEY_RUN_END ? -1 : 1;
+    if (data[1])
+      return 1;
+    data += 2;
+    len -= 2;
+  }
+
+  return 0;
+}
+
+static int
+verkeycmp(const struct versionkey *val, const struct versionkey *ref)
+{
+  size_t len;
+  int r;
+
+  len = val->len < ref->len ? val->len : ref->len;
+  r = memcmp(val->data, ref->data, len);
+  if (r)
+    return r;
+
+  if (val->len > len)
+    return verkey_tail(val->data + len, val->len - len);
+  if (ref->len > len)
+    return -verkey_tail(ref->data + len, ref->len - len);
+  return 0;
+}
+
 int versioncompare(const struct versionrevision *version,
                    const struct versionrevision *refversion) {
   int r;
 
   if (version->epoch > refversion->epoch) return 1;
   if (version->epoch < refversion->epoch) return -1;
-  r= verrevcmp(version->version,refversion->version);  if (r) return r;
-  return verrevcmp(version->revision,refversion->revision);
+
+  if (version->version_key && refversion->version_key)
+    r = verkeycmp(version->version_key, refversion->version_key);
+  else
+    r = verrevcmp(version->version, refversion->version);
+  if (r) return r;
+
+  if (version->revision_key && refversion->revision_key)
+    return verkeycmp(version->revision_key, refversion->revision_key);
+  else
+    return verrevcmp(version->revision, refversion->revision);
 }
 
 bool
@@ -102,5 +236,21 @@ versionsatisfied3(const struct versionrevision *it,
 bool
 versionsatisfied(struct pkginfoperfile *it, struct deppossi *against)
 {
-  return versionsatisfied3(&it->version,&against->version,against->verrel);
+  const struct versionrevision *version = &it->version;
+
+  if (against->verrel == dvr_none)
+    return true;
+
+  if (against->cache.valid &&
+      against->cache.version.epoch == version->epoch &&
+      against->cache.version.version == version->version &&
+      against->cache.version.revision == version->revision)
+    return against->cache.satisfied;
+
+  against->cache.satisfied = versionsatisfied3(version, &against->version,
+                                               against->verrel);
+  against->cache.version = *version;
+  against->cache.valid = true;
+
+  return against->cache.satisfied;
 }
@@ -30,7 +30,6 @@
 #include <ctype.h>
 #include <string.h>
 #include <time.h>
-#include <utime.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -43,10 +42,12 @@
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
 #include <dpkg/path.h>
+#include <dpkg/dir.h>
 #include <dpkg/buffer.h>
 #include <dpkg/subproc.h>
 #include <dpkg/command.h>
 #include <dpkg/tarfn.h>
+#include <dpkg/timing.h>
 #include <dpkg/myopt.h>
 #include <dpkg/triglib.h>
 
@@ -209,6 +210,23 @@ struct pkg_deconf_list *deconfigure = NULL;
 
 static time_t currenttime;
 
+/* The objects get extracted relative to a descriptor of their parent
+ * directory, to avoid walking the whole pathname for each of the several
+ * operations done on them.  All the operations for an object happen in
+ * its parent directory, so the cached descriptor cannot become stale
+ * while it is being used. */
+static struct dir_cache extract_dirs;
+
+void
+extractdirs_close(void)
+{
+  dir_cache_close(&extract_dirs);
+}
+
+void cu_extractdirs(int argc, void **argv) {
+  extractdirs_close();
+}
+
 static int
 does_replace(struct pkginfo *newpigp, struct pkginfoperfile *newpifp,
              struct pkginfo *oldpigp, struct pkginfoperfile *oldpifp)
@@ -231,26 +249,36 @@ does_replace(struct pkginfo *newpigp, struct pkginfoperfile *newpifp,
 }
 
 static void
-newtarobject_utime(const char *path, struct tar_entry *ti)
+newtarobject_times(struct timespec ts[2], struct tar_entry *ti)
+{
+  ts[0].tv_sec = currenttime;
+  ts[0].tv_nsec = 0;
+  ts[1].tv_sec = ti->mtime;
+  ts[1].tv_nsec = 0;
+}
+
+static void
+newtarobject_utime(int dirfd, const char *path, struct tar_entry *ti)
 {
-  struct utimbuf utb;
-  utb.actime= currenttime;
-  utb.modtime = ti->mtime;
-  if (utime(path,&utb))
+  struct timespec ts[2];
+
+  newtarobject_times(ts, ti);
+  if (utimensat(dirfd, path, ts, 0))
     ohshite(_("error setting timestamps of `%.255s'"), ti->name);
 }
 
 static void
-newtarobject_allmodes(const char *path, struct tar_entry *ti,
+newtarobject_allmodes(int dirfd, const char *path, struct tar_entry *ti,
                       struct filestatoverride *statoverride)
 {
-  if (chown(path,
-            statoverride ? statoverride->uid : ti->uid,
-            statoverride ? statoverride->gid : ti->gid))
+  if (fchownat(dirfd, path,
+               statoverride ? statoverride->uid : ti->uid,
+               statoverride ? statoverride->gid : ti->gid, 0))
     ohshite(_("error setting ownership of `%.255s'"), ti->name);
-  if (chmod(path,(statoverride ? statoverride->mode : ti->mode) & ~S_IFMT))
+  if (fchmodat(dirfd, path,
+               (statoverride ? statoverride->mode : ti->mode) & ~S_IFMT, 0))
     ohshite(_("error setting permissions of `%.255s'"), ti->name);
-  newtarobject_utime(path,ti);
+  newtarobject_utime(dirfd, path, ti);
 }
 
 static void
@@ -419,6 +447,8 @@ tarobject(void *ctx, struct tar_entry *ti)
   struct fileinlist *nifd, **oldnifd;
   struct pkginfo *divpkg, *otherpkg;
   mode_t am;
+  const char *name, *tmpname, *newname;
+  int dirfd;
 
   ensureobstackinit();
 
@@ -474,7 +504,13 @@ tarobject(void *ctx, struct tar_entry *ti)
   
   setupfnamevbs(usename);
 
-  statr= lstat(fnamevb.buf,&stab);
+  /* The three pathnames only differ in their extension. */
+  dirfd = dir_cache_open(&extract_dirs, fnamevb.buf, &name);
+  tmpname = fnametmpvb.buf + (name - fnamevb.buf);
+  newname = fnamenewvb.buf + (name - fnamevb.buf);
+
+  timing_count(timing_lstat);
+  statr = fstatat(dirfd, name, &stab, AT_SYMLINK_NOFOLLOW);
   if (statr) {
     /* The lstat failed. */
     if (errno != ENOENT && errno != ENOTDIR)
@@ -485,14 +521,16 @@ tarobject(void *ctx, struct tar_entry *ti)
      * backup/restore operation and were rudely interrupted.
      * So, we see if we have .dpkg-tmp, and if so we restore it.
      */
-    if (rename(fnametmpvb.buf,fnamevb.buf)) {
+    timing_count(timing_rename);
+    if (renameat(dirfd, tmpname, dirfd, name)) {
       if (errno != ENOENT && errno != ENOTDIR)
         ohshite(_("unable to clean up mess surrounding `%.255s' before "
                   "installing another version"), ti->name);
       debug(dbg_eachfiledetail,"tarobject nonexistent");
     } else {
       debug(dbg_eachfiledetail,"tarobject restored tmp to main");
-      statr= lstat(fnamevb.buf,&stab);
+      timing_count(timing_lstat);
+      statr = fstatat(dirfd, name, &stab, AT_SYMLINK_NOFOLLOW);
       if (statr) ohshite(_("unable to stat restored `%.255s' before installing"
                            " another version"), ti->name);
     }
@@ -518,7 +556,7 @@ tarobject(void *ctx, struct tar_entry *ti)
     break;
   case tar_filetype_dir:
     /* If it's already an existing directory, do nothing. */
-    if (!stat(fnamevb.buf,&stabtmp) && S_ISDIR(stabtmp.st_mode)) {
+    if (!fstatat(dirfd, name, &stabtmp, 0) && S_ISDIR(stabtmp.st_mode)) {
       debug(dbg_eachfiledetail, "tarobject directory exists");
       existingdirectory = true;
     }
@@ -646,14 +684,16 @@ tarobject(void *ctx, struct tar_entry *ti)
     return 0;
   }
 
+  tc->files++;
+
   if (existingdirectory)
     return 0;
 
   /* Now, at this stage we want to make sure neither of .dpkg-new and .dpkg-tmp
    * are hanging around.
    */
-  ensure_pathname_nonexisting(fnamenewvb.buf);
-  ensure_pathname_nonexisting(fnametmpvb.buf);
+  ensure_pathname_nonexisting_at(dirfd, newname, fnamenewvb.buf);
+  ensure_pathname_nonexisting_at(dirfd, tmpname, fnametmpvb.buf);
 
   /* Now we start to do things that we need to be able to undo
    * if something goes wrong.  Watch out for the CLEANUP comments to
@@ -671,13 +711,14 @@ tarobject(void *ctx, struct tar_entry *ti)
     /* We create the file with mode 0 to make sure nobody can do anything with
      * it until we apply the proper mode, which might be a statoverride.
      */
-    fd= open(fnamenewvb.buf, (O_CREAT|O_EXCL|O_WRONLY), 0);
+    fd = openat(dirfd, newname, (O_CREAT|O_EXCL|O_WRONLY), 0);
     if (fd < 0)
       ohshite(_("unable to create `%.255s' (while processing `%.255s')"),
               fnamenewvb.buf, ti->name);
     push_cleanup(cu_closefd, ehflag_bombout, NULL, 0, 1, &fd);
     debug(dbg_eachfiledetail, "tarobject file open size=%lu",
           (unsigned long)ti->size);
+    tc->bytes += ti->size;
     { char fnamebuf[256];
     fd_fd_copy(tc->backendpipe, fd, ti->size,
                _("backend dpkg-deb during `%.255s'"),
@@ -702,6 +743,13 @@ tarobject(void *ctx, struct tar_entry *ti)
           nifd->namenode->statoverride->mode : ti->mode) & ~S_IFMT;
     if (fchmod(fd,am))
       ohshite(_("error setting permissions of `%.255s'"), ti->name);
+    {
+      struct timespec ts[2];
+
+      newtarobject_times(ts, ti);
+      if (futimens(fd, ts))
+        ohshite(_("error setting timestamps of `%.255s'"), ti->name);
+    }
 
     /* Postpone the fsync, to try to avoid massive I/O degradation. */
     nifd->namenode->flags |= fnnf_deferred_fsync;
@@ -709,25 +757,24 @@ tarobject(void *ctx, struct tar_entry *ti)
     pop_cleanup(ehflag_normaltidy); /* fd= open(fnamenewvb.buf) */
     if (close(fd))
       ohshite(_("error closing/writing `%.255s'"), ti->name);
-    newtarobject_utime(fnamenewvb.buf,ti);
     break;
   case tar_filetype_fifo:
-    if (mkfifo(fnamenewvb.buf,0))
+    if (mkfifoat(dirfd, newname, 0))
       ohshite(_("error creating pipe `%.255s'"), ti->name);
     debug(dbg_eachfiledetail, "tarobject fifo");
-    newtarobject_allmodes(fnamenewvb.buf,ti, nifd->namenode->statoverride);
+    newtarobject_allmodes(dirfd, newname, ti, nifd->namenode->statoverride);
     break;
   case tar_filetype_chardev:
-    if (mknod(fnamenewvb.buf, S_IFCHR, ti->dev))
+    if (mknodat(dirfd, newname, S_IFCHR, ti->dev))
       ohshite(_("error creating device `%.255s'"), ti->name);
     debug(dbg_eachfiledetail, "tarobject chardev");
-    newtarobject_allmodes(fnamenewvb.buf,ti, nifd->namenode->statoverride);
+    newtarobject_allmodes(dirfd, newname, ti, nifd->namenode->statoverride);
     break; 
   case tar_filetype_blockdev:
-    if (mknod(fnamenewvb.buf, S_IFBLK, ti->dev))
+    if (mknodat(dirfd, newname, S_IFBLK, ti->dev))
       ohshite(_("error creating device `%.255s'"), ti->name);
     debug(dbg_eachfiledetail, "tarobject blockdev");
-    newtarobject_allmodes(fnamenewvb.buf,ti, nifd->namenode->statoverride);
+    newtarobject_allmodes(dirfd, newname, ti, nifd->namenode->statoverride);
     break; 
   case tar_filetype_hardlink:
     varbufreset(&hardlinkfn);
@@ -737,29 +784,30 @@ tarobject(void *ctx, struct tar_entry *ti)
     if (linknode->flags & fnnf_deferred_rename)
       varbufaddstr(&hardlinkfn, DPKGNEWEXT);
     varbufaddc(&hardlinkfn, '\0');
-    if (link(hardlinkfn.buf,fnamenewvb.buf))
+    if (linkat(AT_FDCWD, hardlinkfn.buf, dirfd, newname, 0))
       ohshite(_("error creating hard link `%.255s'"), ti->name);
     debug(dbg_eachfiledetail, "tarobject hardlink");
-    newtarobject_allmodes(fnamenewvb.buf,ti, nifd->namenode->statoverride);
+    newtarobject_allmodes(dirfd, newname, ti, nifd->namenode->statoverride);
     break;
   case tar_filetype_symlink:
     /* We've already cheched for an existing directory. */
-    if (symlink(ti->linkname, fnamenewvb.buf))
+    if (symlinkat(ti->linkname, dirfd, newname))
       ohshite(_("error creating symbolic link `%.255s'"), ti->name);
     debug(dbg_eachfiledetail, "tarobject symlink creating");
-    if (lchown(fnamenewvb.buf,
-               nifd->namenode->statoverride ?
-               nifd->namenode->statoverride->uid : ti->uid,
-               nifd->namenode->statoverride ?
-               nifd->namenode->statoverride->gid : ti->gid))
+    if (fchownat(dirfd, newname,
+                 nifd->namenode->statoverride ?
+                 nifd->namenode->statoverride->uid : ti->uid,
+                 nifd->namenode->statoverride ?
+                 nifd->namenode->statoverride->gid : ti->gid,
+                 AT_SYMLINK_NOFOLLOW))
       ohshite(_("error setting ownership of symlink `%.255s'"), ti->name);
     break;
   case tar_filetype_dir:
     /* We've already checked for an existing directory. */
-    if (mkdir(fnamenewvb.buf,0))
+    if (mkdirat(dirfd, newname, 0))
       ohshite(_("error creating directory `%.255s'"), ti->name);
     debug(dbg_eachfiledetail, "tarobject directory creating");
-    newtarobject_allmodes(fnamenewvb.buf,ti,nifd->namenode->statoverride);
+    newtarobject_allmodes(dirfd, newname, ti, nifd->namenode->statoverride);
     break;
   default:
     internerr("unknown tar type '%d', but already checked", ti->type);
@@ -794,7 +842,8 @@ tarobject(void *ctx, struct tar_entry *ti)
       /* One of the two is a directory - can't do atomic install. */
       debug(dbg_eachfiledetail,"tarobject directory, nonatomic");
       nifd->namenode->flags |= fnnf_no_atomic_overwrite;
-      if (rename(fnamevb.buf,fnametmpvb.buf))
+      timing_count(timing_rename);
+      if (renameat(dirfd, name, dirfd, tmpname))
         ohshite(_("unable to move aside `%.255s' to install new version"),
                 ti->name);
     } else if (S_ISLNK(stab.st_mode)) {
@@ -803,20 +852,21 @@ tarobject(void *ctx, struct tar_entry *ti)
        */
       varbufreset(&symlinkfn);
       varbuf_grow(&symlinkfn, stab.st_size + 1);
-      r = readlink(fnamevb.buf, symlinkfn.buf, symlinkfn.size);
+      r = readlinkat(dirfd, name, symlinkfn.buf, symlinkfn.size);
       if (r < 0)
         ohshite(_("unable to read link `%.255s'"), ti->name);
       assert(r == stab.st_size);
       varbuf_trunc(&symlinkfn, r);
       varbufaddc(&symlinkfn, '\0');
-      if (symlink(symlinkfn.buf,fnametmpvb.buf))
+      if (symlinkat(symlinkfn.buf, dirfd, tmpname))
         ohshite(_("unable to make backup symlink for `%.255s'"), ti->name);
-      if (lchown(fnametmpvb.buf,stab.st_uid,stab.st_gid))
+      if (fchownat(dirfd, tmpname, stab.st_uid, stab.st_gid,
+                   AT_SYMLINK_NOFOLLOW))
         ohshite(_("unable to chown backup symlink for `%.255s'"), ti->name);
       set_selinux_path_context(fnamevb.buf, fnametmpvb.buf, stab.st_mode);
     } else {
       debug(dbg_eachfiledetail,"tarobject nondirectory, `link' backup");
-      if (link(fnamevb.buf,fnametmpvb.buf))
+      if (linkat(dirfd, name, dirfd, tmpname, 0))
         ohshite(_("unable to make backup link of `%.255s' before installing new version"),
                 ti->name);
     }
@@ -831,7 +881,8 @@ tarobject(void *ctx, struct tar_entry *ti)
 
     debug(dbg_eachfiledetail, "tarobject done and installation deferred");
   } else {
-    if (rename(fnamenewvb.buf, fnamevb.buf))
+    timing_count(timing_rename);
+    if (renameat(dirfd, newname, dirfd, name))
       ohshite(_("unable to install new version of `%.255s'"), ti->name);
 
     /* CLEANUP: now the new file is in the destination file, and the
@@ -853,7 +904,8 @@ tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
 {
   struct fileinlist *cfile;
   struct filenamenode *usenode;
-  const char *usename;
+  const char *usename, *name, *newname;
+  int dirfd;
 
 #if !defined(HAVE_ASYNC_SYNC)
   debug(dbg_general, "deferred extract mass sync");
@@ -871,15 +923,19 @@ tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
 
     setupfnamevbs(usename);
 
+    dirfd = dir_cache_open(&extract_dirs, fnamevb.buf, &name);
+    newname = fnamenewvb.buf + (name - fnamevb.buf);
+
 #if defined(HAVE_ASYNC_SYNC)
     if (cfile->namenode->flags & fnnf_deferred_fsync) {
       int fd;
 
       debug(dbg_eachfiledetail, "deferred extract needs fsync");
 
-      fd = open(fnamenewvb.buf, O_WRONLY);
+      fd = openat(dirfd, newname, O_WRONLY);
       if (fd < 0)
         ohshite(_("unable to open '%.255s'"), fnamenewvb.buf);
+      timing_count(timing_fsync);
       if (fsync(fd))
         ohshite(_("unable to sync file '%.255s'"), fnamenewvb.buf);
       if (close(fd))
@@ -891,7 +947,8 @@ tar_deferred_extract(struct fileinlist *files, struct pkginfo *pkg)
 
     debug(dbg_eachfiledetail, "deferred extract needs rename");
 
-    if (rename(fnamenewvb.buf, fnamevb.buf))
+    timing_count(timing_rename);
+    if (renameat(dirfd, newname, dirfd, name))
       ohshite(_("unable to install new version of `%.255s'"),
               cfile->namenode->name);
 
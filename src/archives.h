@@ -27,6 +27,9 @@ struct tarcontext {
   int backendpipe;
   struct pkginfo *pkg;
   struct fileinlist **newfilesp;
+  /* Extraction throughput, reported on the status event fd. */
+  unsigned long files;
+  off_t bytes;
 };
 
 struct pkg_deconf_list {
@@ -50,6 +53,8 @@ void cu_fileslist(int argc, void **argv);
 void cu_backendpipe(int argc, void **argv);
 
 void cu_installnew(int argc, void **argv);
+void extractdirs_close(void);
+void cu_extractdirs(int argc, void **argv);
 
 void cu_prermupgrade(int argc, void **argv);
 void cu_prerminfavour(int argc, void **argv);
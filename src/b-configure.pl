@@ -0,0 +1,168 @@
+#!/usr/bin/perl
+#
+# b-configure.pl - benchmark the package queue processing on large graphs
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+
+use File::Path;
+use File::Spec;
+use Getopt::Long;
+use Time::HiRes qw(time);
+
+# Each graph is an admin directory generated by gen-admindir with all the
+# packages unpacked, which dpkg then configures with --no-act, so that only
+# the queue processing and the dependency checks get measured. The
+# packages depend on random earlier ones, and on top of that each run of
+# "cycles" consecutive packages can be made into a dependency cycle, or all
+# of them with -1. The cyclic graphs are kept smaller, as breaking the
+# cycles gets expensive.
+my @graphs = (
+    {
+        name => 'acyclic',
+        packages => 2000,
+        cycles => 0,
+    },
+    {
+        name => 'short-cycles',
+        packages => 400,
+        cycles => 5,
+    },
+    {
+        name => 'long-cycles',
+        packages => 400,
+        cycles => 100,
+    },
+    {
+        name => 'one-cycle',
+        packages => 400,
+        cycles => -1,
+    },
+);
+
+my $builddir = '.';
+my $tmpdir = 'bench-configure.tmp';
+my $gen_admindir;
+my $scale = 1;
+my @only;
+
+sub usage {
+    print "Usage: $0 [<option>...]
+
+Options:
+  --builddir=<dir>   Directory with the built dpkg programs (default: .).
+  --tmpdir=<dir>     Directory where to generate the graphs
+                       (default: $tmpdir).
+  --gen-admindir=<program>
+                     The gen-admindir program (default: <builddir>/
+                       ../lib/dpkg/test/gen-admindir).
+  --scale=<n>        Multiply the number of packages by <n> (default: 1).
+  --graph=<name>     Only run the named graph, can be repeated; one of:
+                       " . join(', ', map { $_->{name} } @graphs) . ".
+  -?, --help         Show this help message.
+";
+}
+
+GetOptions(
+    'builddir=s' => \$builddir,
+    'tmpdir=s' => \$tmpdir,
+    'gen-admindir=s' => \$gen_admindir,
+    'scale=i' => \$scale,
+    'graph=s' => \@only,
+    'help|?' => sub { usage(); exit(0); },
+) or do { usage(); exit(2); };
+
+$builddir = File::Spec->rel2abs($builddir);
+$tmpdir = File::Spec->rel2abs($tmpdir);
+$gen_admindir //= "$builddir/../lib/dpkg/test/gen-admindir";
+
+my $dpkg = "$builddir/dpkg";
+
+foreach my $prog ($dpkg, $gen_admindir) {
+    die "$0: $prog is not available, build it first\n" unless -x $prog;
+}
+
+$ENV{LC_ALL} = 'C';
+
+# Returns the last record appended to the timing log.
+sub read_timing {
+    my ($log) = @_;
+    my $last = '';
+
+    open(my $fh, '<', $log) or die "$0: cannot open $log: $!\n";
+    $last = $_ while (<$fh>);
+    close($fh);
+
+    my %timing;
+    $timing{maxrss_kb} = $last =~ m/"maxrss_kb":(\d+)/ ? $1 : 0;
+    $timing{dependencies_ok} = $last =~ m/"dependencies_ok":(\d+)/ ? $1 : 0;
+    $timing{order_queue} =
+        $last =~ m/"order_queue":\{"calls":\d+,"seconds":([0-9.]+)\}/ ? $1 : 0;
+
+    return %timing;
+}
+
+sub run_graph {
+    my ($graph) = @_;
+    my $admindir = "$tmpdir/$graph->{name}";
+    my $log = "$tmpdir/timing.log";
+    my $packages = $graph->{packages} * $scale;
+    my $cycles = $graph->{cycles} < 0 ? $packages : $graph->{cycles};
+
+    rmtree($admindir);
+    my @gen = ($gen_admindir, '--unpacked');
+    push @gen, "--cycles=$cycles" if $cycles;
+    system(@gen, $admindir, $packages, 1) == 0
+        or die "$0: cannot generate the $graph->{name} graph\n";
+
+    my @cmd = ($dpkg, "--admindir=$admindir", "--instdir=$tmpdir",
+               '--force-not-root', '--force-bad-path', '--no-act',
+               "--timing-log=$log", '--configure', '--pending');
+
+    my $start = time;
+
+    my $pid = fork();
+    die "$0: cannot fork: $!\n" unless defined $pid;
+    if ($pid == 0) {
+        open(STDOUT, '>', '/dev/null') or die "$0: cannot redirect: $!\n";
+        exec(@cmd) or die "$0: cannot exec $dpkg: $!\n";
+    }
+    waitpid($pid, 0);
+    my $status = $? >> 8;
+    warn "$0: configuring the $graph->{name} graph failed\n" if $?;
+
+    my $seconds = time - $start;
+    my %timing = read_timing($log);
+
+    printf '{"bench":"configure","case":"%s","ops":%d,"status":%d,' .
+           '"seconds":%.6f,"order_queue_seconds":%.6f,' .
+           '"dependencies_ok":%d,"maxrss_kb":%d}' . "\n",
+           $graph->{name}, $packages, $status, $seconds,
+           $timing{order_queue}, $timing{dependencies_ok},
+           $timing{maxrss_kb};
+
+    rmtree($admindir);
+}
+
+mkpath($tmpdir);
+
+foreach my $graph (@graphs) {
+    next if @only and not grep { $_ eq $graph->{name} } @only;
+
+    run_graph($graph);
+}
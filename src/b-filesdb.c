@@ -0,0 +1,119 @@
+/*
+ * dpkg - main program for package management
+ * b-filesdb.c - benchmark the files database
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/test.h>
+#include <dpkg/bench.h>
+#include <dpkg/dpkg-db.h>
+
+#include "filesdb.h"
+
+#define FINDNAMENODE_ROUNDS 10
+
+const char *admindir;
+
+static const char **
+bench_filenames(int *count)
+{
+	struct fileiterator *it;
+	struct filenamenode *fnn;
+	const char **names = NULL;
+	int n = 0, size = 0;
+
+	it = iterfilestart();
+	while ((fnn = iterfilenext(it))) {
+		if (n == size) {
+			size = size ? size * 2 : 4096;
+			names = m_realloc(names, sizeof(names[0]) * size);
+		}
+		names[n++] = fnn->name;
+	}
+	iterfileend(it);
+
+	*count = n;
+
+	return names;
+}
+
+static void
+bench_findnamenode(void)
+{
+	const char **names;
+	char **missing;
+	double start;
+	int i, n, round;
+
+	names = bench_filenames(&n);
+
+	missing = m_malloc(sizeof(missing[0]) * n);
+	for (i = 0; i < n; i++) {
+		missing[i] = m_malloc(strlen(names[i]) + strlen(DPKGTEMPEXT) + 1);
+		sprintf(missing[i], "%s%s", names[i], DPKGTEMPEXT);
+	}
+
+	start = bench_time();
+	for (round = 0; round < FINDNAMENODE_ROUNDS; round++)
+		for (i = 0; i < n; i++)
+			findnamenode(names[i], fnn_nonew);
+	bench_report("filesdb", "findnamenode", n * FINDNAMENODE_ROUNDS, start);
+
+	start = bench_time();
+	for (round = 0; round < FINDNAMENODE_ROUNDS; round++)
+		for (i = 0; i < n; i++)
+			findnamenode(missing[i], fnn_nonew);
+	bench_report("filesdb", "findnamenode-miss", n * FINDNAMENODE_ROUNDS,
+	             start);
+
+	for (i = 0; i < n; i++)
+		free(missing[i]);
+	free(missing);
+	free(names);
+}
+
+static void
+test(void)
+{
+	double start;
+
+	admindir = bench_admindir();
+	modstatdb_init(admindir, msdbrw_readonly);
+
+	start = bench_time();
+	ensure_allinstfiles_available_quiet();
+	bench_report("filesdb", "ensure_allinstfiles_available", countpackages(),
+	             start);
+
+	start = bench_time();
+	ensure_diversions();
+	bench_report("filesdb", "ensure_diversions", 1, start);
+
+	start = bench_time();
+	ensure_statoverrides();
+	bench_report("filesdb", "ensure_statoverrides", 1, start);
+
+	bench_findnamenode();
+
+	modstatdb_shutdown();
+}
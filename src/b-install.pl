@@ -0,0 +1,293 @@
+#!/usr/bin/perl
+#
+# b-install.pl - benchmark package installation, upgrade and removal
+#
+# Copyright © 2026 agent <agent@local>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+use strict;
+use warnings;
+
+use File::Path;
+use File::Spec;
+use Getopt::Long;
+use POSIX ();
+use Time::HiRes qw(time);
+
+# Each corpus is a set of packages built twice, with different versions,
+# so that the second build can be used to measure upgrades. The file
+# contents are the same random block repeated, so that the compressors
+# do not reduce them to nothing, but building the corpus stays cheap.
+# There are no maintainer scripts, as these get run chrooted into the
+# root directory, which has no shell.
+my @corpora = (
+    {
+        name => 'small-files',
+        packages => 40,
+        files => 200,
+        size => 512,
+        compressor => 'gzip',
+    },
+    {
+        name => 'large-files',
+        packages => 4,
+        files => 8,
+        size => 4 * 1024 * 1024,
+        compressor => 'xz',
+    },
+    {
+        name => 'conffiles',
+        packages => 20,
+        files => 20,
+        size => 4096,
+        conffiles => 5,
+        compressor => 'bzip2',
+    },
+    {
+        name => 'uncompressed',
+        packages => 20,
+        files => 100,
+        size => 8192,
+        compressor => 'none',
+    },
+);
+
+my $builddir = '.';
+my $tmpdir = 'bench-install.tmp';
+my $rootdir;
+my $build_with;
+my $scale = 1;
+my @only;
+
+sub usage {
+    print "Usage: $0 [<option>...]
+
+Options:
+  --builddir=<dir>   Directory with the built dpkg programs (default: .).
+  --tmpdir=<dir>     Directory where to build the corpus (default: $tmpdir).
+  --root=<dir>       Directory where to install the packages, for example
+                       a tmpfs or a loop mounted file system; its contents
+                       are removed (default: <tmpdir>/root).
+  --build-with=<prog> Build the corpus with <prog> instead of the built
+                       dpkg-deb, which is still used for unpacking.
+  --scale=<n>        Multiply the number of packages by <n> (default: 1).
+  --corpus=<name>    Only run the named corpus, can be repeated; one of:
+                       " . join(', ', map { $_->{name} } @corpora) . ".
+  -?, --help         Show this help message.
+";
+}
+
+GetOptions(
+    'builddir=s' => \$builddir,
+    'tmpdir=s' => \$tmpdir,
+    'root=s' => \$rootdir,
+    'build-with=s' => \$build_with,
+    'scale=i' => \$scale,
+    'corpus=s' => \@only,
+    'help|?' => sub { usage(); exit(0); },
+) or do { usage(); exit(2); };
+
+$builddir = File::Spec->rel2abs($builddir);
+$tmpdir = File::Spec->rel2abs($tmpdir);
+$rootdir = File::Spec->rel2abs($rootdir // "$tmpdir/root");
+
+my $dpkg = "$builddir/dpkg";
+my $dpkg_deb = "$builddir/../dpkg-deb/dpkg-deb";
+
+foreach my $prog ($dpkg, $dpkg_deb) {
+    die "$0: $prog is not available, build it first\n" unless -x $prog;
+}
+
+$build_with //= $dpkg_deb;
+
+# The dpkg program runs dpkg-deb from the PATH.
+$ENV{PATH} = "$builddir/../dpkg-deb:$builddir:$ENV{PATH}";
+$ENV{LC_ALL} = 'C';
+
+my $ticks = POSIX::sysconf(POSIX::_SC_CLK_TCK);
+
+srand(1);
+my $block = join('', map { chr(int(rand(256))) } 1 .. 4096);
+
+sub write_file {
+    my ($file, $content) = @_;
+
+    open(my $fh, '>', $file) or die "$0: cannot create $file: $!\n";
+    print { $fh } $content;
+    close($fh) or die "$0: cannot write $file: $!\n";
+}
+
+sub file_content {
+    my ($size, $tag) = @_;
+    my $content = "$tag\n";
+
+    $content .= $block x (int($size / length($block)) + 1);
+
+    return substr($content, 0, $size);
+}
+
+sub build_package {
+    my ($corpus, $pkg, $version) = @_;
+    my $dir = "$tmpdir/$corpus->{name}/build/$pkg";
+    my $deb = "$tmpdir/$corpus->{name}/${pkg}_${version}_all.deb";
+
+    rmtree($dir);
+    mkpath(["$dir/DEBIAN", "$dir/usr/share/$pkg"]);
+
+    my $control = "Package: $pkg
+Version: $version
+Architecture: all
+Maintainer: Benchmark <bench\@example.org>
+Installed-Size: " . int($corpus->{files} * $corpus->{size} / 1024) . "
+Description: benchmark package $pkg
+ This package has been generated to benchmark dpkg.
+";
+    write_file("$dir/DEBIAN/control", $control);
+
+    foreach my $i (1 .. $corpus->{files}) {
+        write_file("$dir/usr/share/$pkg/file-$i",
+                   file_content($corpus->{size}, "$pkg $version $i"));
+    }
+
+    if ($corpus->{conffiles}) {
+        my @conffiles;
+
+        mkpath("$dir/etc/$pkg");
+        foreach my $i (1 .. $corpus->{conffiles}) {
+            write_file("$dir/etc/$pkg/conf-$i", "$pkg $version $i\n");
+            push @conffiles, "/etc/$pkg/conf-$i\n";
+        }
+        write_file("$dir/DEBIAN/conffiles", join('', @conffiles));
+    }
+
+    my $ok = system("$build_with -Z$corpus->{compressor} --build $dir $deb >/dev/null") == 0;
+    rmtree($dir);
+
+    return $ok ? $deb : undef;
+}
+
+# Returns the packages built for the corpus, or an empty list if they
+# could not be built, as the in-tree dpkg-deb might not work with the
+# tar found on the system.
+sub build_corpus {
+    my ($corpus, $version, @pkgs) = @_;
+    my @debs;
+
+    foreach my $pkg (@pkgs) {
+        my $deb = build_package($corpus, $pkg, $version);
+
+        if (not defined $deb) {
+            warn "$0: cannot build the $corpus->{name} corpus with " .
+                 "$build_with, skipping it (see --build-with)\n";
+            return ();
+        }
+        push @debs, $deb;
+    }
+
+    return @debs;
+}
+
+sub reset_root {
+    my $admindir = "$rootdir/var/lib/dpkg";
+
+    rmtree($rootdir, { keep_root => 1 }) if -d $rootdir;
+    mkpath(["$admindir/info", "$admindir/updates", "$admindir/triggers"]);
+    write_file("$admindir/status", '');
+    write_file("$admindir/available", '');
+}
+
+# Returns the last record appended to the timing log, by the dpkg run
+# for the phase.
+sub read_timing {
+    my ($log) = @_;
+    my $last = '';
+
+    open(my $fh, '<', $log) or die "$0: cannot open $log: $!\n";
+    $last = $_ while (<$fh>);
+    close($fh);
+
+    my %timing;
+    foreach my $key (qw(maxrss_kb fsync rename)) {
+        $timing{$key} = $last =~ m/"$key":(\d+)/ ? $1 : 0;
+    }
+
+    return %timing;
+}
+
+sub run_phase {
+    my ($corpus, $phase, $npkgs, @args) = @_;
+    my $log = "$tmpdir/timing.log";
+
+    my @cmd = ($dpkg, "--instdir=$rootdir",
+               "--admindir=$rootdir/var/lib/dpkg", '--force-not-root',
+               '--force-bad-path', "--timing-log=$log", @args);
+
+    my @start_cpu = POSIX::times();
+    my $start = time;
+
+    my $pid = fork();
+    die "$0: cannot fork: $!\n" unless defined $pid;
+    if ($pid == 0) {
+        open(STDOUT, '>', '/dev/null') or die "$0: cannot redirect: $!\n";
+        exec(@cmd) or die "$0: cannot exec $dpkg: $!\n";
+    }
+    waitpid($pid, 0);
+    my $status = $? >> 8;
+    warn "$0: '$phase' phase failed for corpus $corpus->{name}\n" if $?;
+
+    my $seconds = time - $start;
+    my @end_cpu = POSIX::times();
+    my %timing = read_timing($log);
+
+    printf '{"bench":"install","case":"%s-%s","ops":%d,"status":%d,' .
+           '"seconds":%.6f,"user_seconds":%.6f,"system_seconds":%.6f,' .
+           '"fsync":%d,"rename":%d,"maxrss_kb":%d}' . "\n",
+           $corpus->{name}, $phase, $npkgs, $status, $seconds,
+           ($end_cpu[3] - $start_cpu[3]) / $ticks,
+           ($end_cpu[4] - $start_cpu[4]) / $ticks,
+           $timing{fsync}, $timing{rename}, $timing{maxrss_kb};
+}
+
+sub run_corpus {
+    my ($corpus) = @_;
+    my $npkgs = $corpus->{packages} * $scale;
+    my @pkgs = map { "bench-$corpus->{name}-$_" } 1 .. $npkgs;
+
+    rmtree("$tmpdir/$corpus->{name}");
+    my @debs_old = build_corpus($corpus, '1.0-1', @pkgs);
+    my @debs_new;
+    @debs_new = build_corpus($corpus, '2.0-1', @pkgs) if @debs_old;
+    if (not @debs_new) {
+        rmtree("$tmpdir/$corpus->{name}");
+        return;
+    }
+
+    reset_root();
+    run_phase($corpus, 'unpack', $npkgs, '--unpack', @debs_old);
+    run_phase($corpus, 'configure', $npkgs, '--configure', '--pending');
+    run_phase($corpus, 'upgrade', $npkgs, '--install', @debs_new);
+    run_phase($corpus, 'remove', $npkgs, '--remove', @pkgs);
+    run_phase($corpus, 'purge', $npkgs, '--purge', @pkgs);
+
+    rmtree("$tmpdir/$corpus->{name}");
+}
+
+mkpath($tmpdir);
+
+foreach my $corpus (@corpora) {
+    next if @only and not grep { $_ eq $corpus->{name} } @only;
+
+    run_corpus($corpus);
+}
@@ -0,0 +1,161 @@
+/*
+ * dpkg - main program for package management
+ * b-trigfile.c - benchmark file trigger activation
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/test.h>
+#include <dpkg/bench.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/varbuf.h>
+#include <dpkg/triglib.h>
+
+#include "filesdb.h"
+
+/*
+ * A package shipping FILES files spread over DIRS directories is unpacked
+ * against INTERESTS file trigger interests, on every other directory.
+ * Each file and directory entry of the package gets its activation
+ * checked, as process_archive() and the removal code do.
+ */
+#define INTERESTS 500
+#define DIRS (INTERESTS * 2)
+#define FILES 100000
+
+const char *admindir;
+
+static struct filenamenode *
+bench_nn_find(const char *name, bool nonew)
+{
+	return findnamenode(name, nonew ? fnn_nonew : 0);
+}
+
+TRIGHOOKS_DEFINE_NAMENODE_ACCESSORS
+
+static const struct trig_hooks bench_hooks = {
+	.enqueue_deferred = NULL,
+	.transitional_activate = NULL,
+	.namenode_find = bench_nn_find,
+	.namenode_interested = th_nn_interested,
+	.namenode_name = th_nn_name,
+};
+
+static void
+bench_mkdir(struct varbuf *path)
+{
+	if (mkdir(path->buf, 0755) < 0 && errno != EEXIST)
+		ohshite("cannot create directory '%s'", path->buf);
+}
+
+/* Set up an admin directory of our own, with only the file triggers. */
+static const char *
+bench_trigdir(void)
+{
+	static struct varbuf dir;
+	struct varbuf path = VARBUF_INIT;
+	FILE *file;
+	int i;
+
+	varbufprintf(&dir, "%s/b-trigfile", bench_admindir());
+	varbufaddc(&dir, '\0');
+	bench_mkdir(&dir);
+
+	varbufprintf(&path, "%s/%s", dir.buf, TRIGGERSDIR);
+	varbufaddc(&path, '\0');
+	bench_mkdir(&path);
+
+	varbufreset(&path);
+	varbufprintf(&path, "%s/%s%s", dir.buf, TRIGGERSDIR, TRIGGERSFILEFILE);
+	varbufaddc(&path, '\0');
+
+	file = fopen(path.buf, "w");
+	if (file == NULL)
+		ohshite("cannot create '%s'", path.buf);
+	for (i = 0; i < INTERESTS; i++)
+		fprintf(file, "/usr/share/trig-%d trig-%d\n", i * 2, i);
+	if (ferror(file) || fclose(file))
+		ohshite("cannot write '%s'", path.buf);
+
+	varbuf_destroy(&path);
+
+	return dir.buf;
+}
+
+static void
+test(void)
+{
+	struct filenamenode **nodes;
+	struct varbuf name = VARBUF_INIT;
+	struct pkginfo *pkg, *aw;
+	double start;
+	int i, n = 0;
+
+	trig_override_hooks(&bench_hooks);
+
+	start = bench_time();
+	trig_incorporate(msdbrw_readonly, bench_trigdir());
+	bench_report("trigfile", "trig_file_interests_ensure", INTERESTS, start);
+
+	/* Only installed packages get their triggers activated. */
+	for (i = 0; i < INTERESTS; i++) {
+		varbufreset(&name);
+		varbufprintf(&name, "trig-%d", i);
+		varbufaddc(&name, '\0');
+		pkg = findpackage(name.buf);
+		pkg->status = stat_installed;
+	}
+	aw = findpackage("bench");
+	aw->status = stat_unpacked;
+
+	nodes = m_malloc(sizeof(nodes[0]) * (DIRS + FILES));
+	for (i = 0; i < DIRS; i++) {
+		varbufreset(&name);
+		varbufprintf(&name, "/usr/share/trig-%d", i);
+		varbufaddc(&name, '\0');
+		nodes[n++] = findnamenode(name.buf, 0);
+	}
+	for (i = 0; i < FILES; i++) {
+		varbufreset(&name);
+		varbufprintf(&name, "/usr/share/trig-%d/file-%d", i % DIRS, i);
+		varbufaddc(&name, '\0');
+		nodes[n++] = findnamenode(name.buf, 0);
+	}
+
+	start = bench_time();
+	for (i = 0; i < n; i++)
+		trig_file_activate(nodes[i], aw);
+	bench_report("trigfile", "trig_file_activate", n, start);
+	test_pass(findpackage("trig-0")->trigpend_head != NULL);
+
+	/* The second time all the triggers are already pending. */
+	start = bench_time();
+	for (i = 0; i < n; i++)
+		trig_file_activate(nodes[i], aw);
+	bench_report("trigfile", "trig_file_activate-pending", n, start);
+
+	free(nodes);
+	varbuf_destroy(&name);
+}
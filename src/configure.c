@@ -28,6 +28,8 @@
 #include <sys/termios.h>
 
 #include <assert.h>
+#include <setjmp.h>
+#include <signal.h>
 #include <errno.h>
 #include <ctype.h>
 #include <string.h>
@@ -214,6 +216,237 @@ deferred_configure_conffile(struct pkginfo *pkg, struct conffile *conff)
 	varbuf_destroy(&cdr2);
 }
 
+/*
+ * Postinst scripts running in the background, see --postinst-jobs.
+ *
+ * A package stays half-configured while its postinst runs, which is
+ * enough for dependencies_ok() to defer anything depending on it; the
+ * status is only moved to installed here, in the main process, once the
+ * script has been reaped.
+ */
+struct postinst_job {
+	struct postinst_job *next;
+	struct pkginfo *pkg;
+	pid_t pid;
+	double start;
+	FILE *output;
+	FILE *errors;
+};
+
+static struct postinst_job *postinst_jobs;
+static int postinst_jobs_count;
+
+int
+postinst_jobs_running(void)
+{
+	return postinst_jobs_count;
+}
+
+static FILE *
+postinst_job_tmpfile(void)
+{
+	FILE *file;
+
+	file = tmpfile();
+	if (file == NULL)
+		ohshite(_("unable to create temporary file for %s output"),
+		        _("installed post-installation script"));
+
+	return file;
+}
+
+static bool
+postinst_job_start(struct pkginfo *pkg, const char *oldversion)
+{
+	struct postinst_job *job;
+	FILE *output, *errors;
+	double start;
+	pid_t pid;
+
+	output = postinst_job_tmpfile();
+	errors = postinst_job_tmpfile();
+
+	start = statusfd_event_clock();
+	pid = maintainer_script_postinst_start(pkg, fileno(output),
+	                                       fileno(errors),
+	                                       "configure", oldversion, NULL);
+	if (pid == 0) {
+		fclose(output);
+		fclose(errors);
+		return false;
+	}
+
+	debug(dbg_scripts, "postinst_job_start %s pid %d, %d running",
+	      pkg->name, (int)pid, postinst_jobs_count + 1);
+
+	job = m_malloc(sizeof(*job));
+	job->pkg = pkg;
+	job->pid = pid;
+	job->start = start;
+	job->output = output;
+	job->errors = errors;
+	job->next = postinst_jobs;
+	postinst_jobs = job;
+	postinst_jobs_count++;
+
+	return true;
+}
+
+static void
+postinst_job_replay(FILE *file, int fd, const char *name)
+{
+	if (fseek(file, 0, SEEK_SET))
+		ohshite(_("unable to rewind %s output"),
+		        _("installed post-installation script"));
+	fd_fd_copy(fileno(file), fd, -1, name);
+}
+
+static void
+postinst_job_done(struct postinst_job *job, int status)
+{
+	struct pkginfo *pkg = job->pkg;
+	jmp_buf ejbuf;
+
+	if (setjmp(ejbuf)) {
+		pkg->clientdata->istobe = itb_normal;
+		error_unwind(ehflag_bombout);
+		return;
+	}
+	push_error_handler(&ejbuf, print_error_perpackage, pkg->name);
+
+	/* Replay the script output as a single block. */
+	m_output(stdout, _("<standard output>"));
+	m_output(stderr, _("<standard error>"));
+	postinst_job_replay(job->output, 1,
+	                    _("installed post-installation script output"));
+	postinst_job_replay(job->errors, 2,
+	                    _("installed post-installation script errors"));
+
+	maintainer_script_postinst_finish(pkg, status, job->start);
+
+	pkg->eflag = eflag_ok;
+	post_postinst_tasks(pkg, stat_installed);
+
+	m_output(stdout, _("<standard output>"));
+	m_output(stderr, _("<standard error>"));
+	set_error_display(NULL, NULL);
+	error_unwind(ehflag_normaltidy);
+}
+
+/*
+ * Find a job which has finished, and remove it from the list. Only the
+ * job pids are waited for, as other children are not ours to reap.
+ */
+static struct postinst_job *
+postinst_jobs_find_done(int *status)
+{
+	struct postinst_job *job, **jobp;
+	pid_t pid;
+
+	for (jobp = &postinst_jobs; (job = *jobp); jobp = &job->next) {
+		pid = waitpid(job->pid, status, WNOHANG);
+		if (pid < 0)
+			ohshite(_("wait for subprocess %s failed"),
+			        _("installed post-installation script"));
+		if (pid == 0)
+			continue;
+
+		*jobp = job->next;
+		postinst_jobs_count--;
+
+		return job;
+	}
+
+	return NULL;
+}
+
+static sigset_t postinst_jobs_sigmask_old;
+static struct sigaction postinst_jobs_sigchld_old;
+
+static void
+postinst_jobs_sigchld(int signo)
+{
+}
+
+static void
+postinst_jobs_sigrestore(int argc, void **argv)
+{
+	sigaction(SIGCHLD, &postinst_jobs_sigchld_old, NULL);
+	sigprocmask(SIG_SETMASK, &postinst_jobs_sigmask_old, NULL);
+}
+
+/*
+ * Wait for any of the jobs to finish. SIGCHLD is blocked while checking
+ * on them, so that a job finishing just after the check still wakes up
+ * sigsuspend().
+ */
+static struct postinst_job *
+postinst_jobs_wait_any(int *status)
+{
+	struct postinst_job *job;
+	struct sigaction sa;
+	sigset_t mask;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &mask, &postinst_jobs_sigmask_old))
+		ohshite(_("unable to block SIGCHLD"));
+
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_handler = postinst_jobs_sigchld;
+	if (sigaction(SIGCHLD, &sa, &postinst_jobs_sigchld_old)) {
+		sigprocmask(SIG_SETMASK, &postinst_jobs_sigmask_old, NULL);
+		ohshite(_("unable to set up SIGCHLD handler"));
+	}
+
+	push_cleanup(postinst_jobs_sigrestore, ~0, NULL, 0, 0);
+
+	while ((job = postinst_jobs_find_done(status)) == NULL)
+		sigsuspend(&postinst_jobs_sigmask_old);
+
+	pop_cleanup(ehflag_normaltidy);
+
+	return job;
+}
+
+/**
+ * Reap finished postinst jobs and finish configuring their packages.
+ *
+ * @param block Wait for at least one job if none has finished yet.
+ */
+void
+postinst_jobs_reap(bool block)
+{
+	struct postinst_job *job;
+	int status;
+
+	while (postinst_jobs_count) {
+		job = postinst_jobs_find_done(&status);
+		if (job == NULL && block)
+			job = postinst_jobs_wait_any(&status);
+		if (job == NULL)
+			break;
+
+		debug(dbg_scripts, "postinst_jobs_reap %s pid %d, %d running",
+		      job->pkg->name, (int)job->pid, postinst_jobs_count);
+
+		postinst_job_done(job, status);
+		fclose(job->output);
+		fclose(job->errors);
+		free(job);
+
+		block = false;
+	}
+}
+
+void
+postinst_jobs_wait(void)
+{
+	while (postinst_jobs_count)
+		postinst_jobs_reap(true);
+}
+
 /**
  * Process the deferred configure package.
  *
@@ -248,6 +481,7 @@ deferred_configure(struct pkginfo *pkg)
 {
 	struct varbuf aemsgs = VARBUF_INIT;
 	struct conffile *conff;
+	const char *oldversion;
 	int ok;
 
 	if (pkg->status == stat_notinstalled)
@@ -344,11 +578,13 @@ deferred_configure(struct pkginfo *pkg)
 
 	modstatdb_note(pkg);
 
-	maintainer_script_postinst(pkg, "configure",
-	                           informativeversion(&pkg->configversion) ?
-	                           versiondescribe(&pkg->configversion,
-	                                           vdew_nonambig) : "",
-	                           NULL);
+	oldversion = informativeversion(&pkg->configversion) ?
+	             versiondescribe(&pkg->configversion, vdew_nonambig) : "";
+
+	if (postinst_jobs_max > 1 && postinst_job_start(pkg, oldversion))
+		return;
+
+	maintainer_script_postinst(pkg, "configure", oldversion, NULL);
 
 	pkg->eflag = eflag_ok;
 	post_postinst_tasks(pkg, stat_installed);
@@ -599,6 +835,15 @@ promptconfaction(struct pkginfo *pkg, const char *cfgfile,
 	              cfgfile, "conffile-prompt",
 	              realold, realnew, useredited, distedited);
 
+	statusfd_event_begin("conffile-prompt");
+	statusfd_event_string("conffile", cfgfile);
+	statusfd_event_string("old", realold);
+	statusfd_event_string("new", realnew);
+	statusfd_event_integer("user-edited", useredited);
+	statusfd_event_integer("dist-edited", distedited);
+	statusfd_event_end();
+	statusfd_event_flush();
+
 	do {
 		/* Flush the terminal's input in case the user involuntarily
 		 * typed some characters. */
@@ -31,6 +31,7 @@
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/pkg-list.h>
 
 #include "main.h"
 
@@ -40,6 +41,9 @@ struct cyclesofarlink {
   struct deppossi *possi;
 };
 
+/* Packages colored by the current findbreakcycle() traversal. */
+static struct pkg_list *cyclevisited;
+
 static bool findbreakcyclerecursive(struct pkginfo *pkg,
                                     struct cyclesofarlink *sofar);
 
@@ -56,12 +60,11 @@ foundcyclebroken(struct cyclesofarlink *thislink, struct cyclesofarlink *sofar,
   /* We're investigating the dependency `possi' to see if it
    * is part of a loop.  To this end we look to see whether the
    * depended-on package is already one of the packages whose
-   * dependencies we're searching.
+   * dependencies we're searching, which are the gray ones, so that
+   * we do not need to walk the whole list for each dependency.
    */
-  for (sol = sofar; sol && sol->pkg != dependedon; sol = sol->prev);
-
-  /* If not, we do a recursive search on it to see what we find. */
-  if (!sol)
+  if (dependedon->clientdata->color != gray)
+    /* If not, we do a recursive search on it to see what we find. */
     return findbreakcyclerecursive(dependedon, thislink);
   
   debug(dbg_depcon,"found cycle");
@@ -106,6 +109,8 @@ findbreakcyclerecursive(struct pkginfo *pkg, struct cyclesofarlink *sofar)
 
   if (pkg->clientdata->color == black)
     return false;
+  if (pkg->clientdata->color == white)
+    pkg_list_prepend(&cyclevisited, pkg);
   pkg->clientdata->color = gray;
   
   if (f_debug & dbg_depcondetail) {
@@ -151,20 +156,31 @@ findbreakcyclerecursive(struct pkginfo *pkg, struct cyclesofarlink *sofar)
   return false;
 }
 
+static void
+cyclevisited_clear(void)
+{
+  struct pkg_list *node;
+
+  for (node = cyclevisited; node; node = node->next)
+    node->pkg->clientdata->color = white;
+  pkg_list_free(cyclevisited);
+  cyclevisited = NULL;
+}
+
 bool
 findbreakcycle(struct pkginfo *pkg)
 {
-  struct pkgiterator *iter;
-  struct pkginfo *tpkg;
-	
-  /* Clear the visited flag of all packages before we traverse them. */
-  iter = iterpkgstart();
-  while ((tpkg = iterpkgnext(iter))) {
-    tpkg->clientdata->color = white;
-  }
-  iterpkgend(iter);
+  bool broken;
+
+  /* All packages start out white, so instead of clearing the visited
+   * flag of the whole database before each traversal, we only clear it
+   * back for the packages we have visited, which is usually a tiny part
+   * of it. Do it beforehand too, in case we bailed out last time. */
+  cyclevisited_clear();
+  broken = findbreakcyclerecursive(pkg, NULL);
+  cyclevisited_clear();
 
-  return findbreakcyclerecursive(pkg, NULL);
+  return broken;
 }
 
 void describedepcon(struct varbuf *addto, struct dependency *dep) {
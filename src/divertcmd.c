@@ -356,8 +356,7 @@ static void
 divertdb_write(void)
 {
 	FILE *dbfile;
-	struct fileiterator *iter;
-	struct filenamenode *namenode;
+	struct diversion *d;
 	struct varbuf dbname = VARBUF_INIT;
 	struct varbuf dbname_new = VARBUF_INIT;
 	struct varbuf dbname_old = VARBUF_INIT;
@@ -371,19 +370,11 @@ divertdb_write(void)
 		ohshite(_("cannot create new %s file"), DIVERSIONSFILE);
 	chmod(dbname_new.buf, 0644);
 
-	iter = iterfilestart();
-	while ((namenode = iterfilenext(iter))) {
-		struct diversion *d = namenode->divert;
-
-		if (d == NULL || d->useinstead == NULL)
-			continue;
-
+	for (d = divertdb_first(); d; d = d->next)
 		fprintf(dbfile, "%s\n%s\n%s\n",
 		        d->useinstead->divert->camefrom->name,
 		        d->useinstead->name,
 		        diversion_pkg_name(d));
-	}
-	iterfileend(iter);
 
 	if (fflush(dbfile))
 		ohshite(_("unable to flush file '%s'"), dbname_new.buf);
@@ -490,6 +481,8 @@ diversion_add(const char *const *argv)
 	contest->camefrom = NULL;
 	contest->pkg = pkg;
 
+	divertdb_add(contest);
+
 	/* Update database and file system if needed. */
 	if (opt_verbose > 0)
 		printf(_("Adding '%s'\n"), diversion_describe(contest));
@@ -558,6 +551,7 @@ diversion_remove(const char *const *argv)
 	/* Remove entries from database. */
 	contest->useinstead->divert = NULL;
 	altname->camefrom->divert = NULL;
+	divertdb_remove(contest);
 
 	if (opt_rename)
 		opt_rename = check_rename(&file_to, &file_from);
@@ -573,8 +567,7 @@ diversion_remove(const char *const *argv)
 static int
 diversion_list(const char *const *argv)
 {
-	struct fileiterator *iter;
-	struct filenamenode *namenode;
+	struct diversion *contest;
 	struct glob_node *glob_list = NULL;
 	const char *pattern;
 
@@ -584,16 +577,11 @@ diversion_list(const char *const *argv)
 	if (glob_list == NULL)
 		glob_list_prepend(&glob_list, m_strdup("*"));
 
-	iter = iterfilestart();
-	while ((namenode = iterfilenext(iter))) {
+	for (contest = divertdb_first(); contest; contest = contest->next) {
 		struct glob_node *g;
-		struct diversion *contest = namenode->divert;
 		struct diversion *altname;
 		const char *pkg_name;
 
-		if (contest->useinstead == NULL)
-			continue;
-
 		altname = contest->useinstead->divert;
 
 		pkg_name = diversion_pkg_name(contest);
@@ -607,7 +595,6 @@ diversion_list(const char *const *argv)
 			}
 		}
 	}
-	iterfileend(iter);
 
 	glob_list_free(glob_list);
 
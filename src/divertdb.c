@@ -40,16 +40,83 @@
 #include "filesdb.h"
 #include "main.h"
 
+/* The diversions, linked through their contested entries, in the order
+ * they appear in the diversions file, so that writing them back does not
+ * shuffle the file around. */
 static struct diversion *diversions = NULL;
+static struct diversion **diversions_tail = &diversions;
 static FILE *diversionsfile = NULL;
 
+struct diversion *
+divertdb_first(void)
+{
+	return diversions;
+}
+
+void
+divertdb_add(struct diversion *contest)
+{
+	contest->next = NULL;
+	*diversions_tail = contest;
+	diversions_tail = &contest->next;
+}
+
+void
+divertdb_remove(struct diversion *contest)
+{
+	struct diversion **dp;
+
+	for (dp = &diversions; *dp; dp = &(*dp)->next) {
+		if (*dp != contest)
+			continue;
+
+		*dp = contest->next;
+		if (diversions_tail == &contest->next)
+			diversions_tail = dp;
+		return;
+	}
+}
+
+/* Returns the next line in the buffer, checked the same way as with
+ * fgets_checked(), or NULL at the end of the buffer. */
+static char *
+divertdb_getline(char **bufp, char *end, const char *fn)
+{
+	char *line = *bufp;
+	char *nl;
+
+	if (line == end)
+		return NULL;
+
+	nl = memchr(line, '\n', end - line);
+	if (nl == NULL || nl - line >= MAXDIVERTFILENAME - 1 ||
+	    memchr(line, '\0', nl - line) != NULL)
+		ohshit(_("too-long line or missing newline in `%.250s'"), fn);
+	*nl = '\0';
+	*bufp = nl + 1;
+
+	return line;
+}
+
+static char *
+divertdb_getline_must(char **bufp, char *end, const char *fn)
+{
+	char *line = divertdb_getline(bufp, end, fn);
+
+	if (line == NULL)
+		ohshit(_("unexpected eof reading `%.250s'"), fn);
+
+	return line;
+}
+
 void
 ensure_diversions(void)
 {
 	static struct varbuf vb;
 
 	struct stat stab1, stab2;
-	char linebuf[MAXDIVERTFILENAME];
+	char *buf, *bufp, *end, *line;
+	ssize_t r;
 	FILE *file;
 	struct diversion *ov, *oicontest, *oialtname;
 
@@ -90,25 +157,40 @@ ensure_diversions(void)
 		ov->useinstead->divert = NULL;
 	}
 	diversions = NULL;
+	diversions_tail = &diversions;
 	if (!file) {
 		onerr_abort--;
 		return;
 	}
 
-	while (fgets_checked(linebuf, sizeof(linebuf), file, vb.buf) >= 0) {
+	/* Slurp the whole file and split it in place, instead of going
+	 * through it a line at a time. */
+	if (fstat(fileno(file), &stab2))
+		ohshite(_("failed to fstat diversions file"));
+	buf = m_malloc(stab2.st_size + 1);
+	end = buf;
+	while (end < buf + stab2.st_size &&
+	       (r = read(fileno(file), end, buf + stab2.st_size - end)) != 0) {
+		if (r < 0)
+			ohshite(_("read error in `%.250s'"), vb.buf);
+		end += r;
+	}
+
+	bufp = buf;
+	while ((line = divertdb_getline(&bufp, end, vb.buf))) {
 		oicontest = nfmalloc(sizeof(struct diversion));
 		oialtname = nfmalloc(sizeof(struct diversion));
 
-		oialtname->camefrom = findnamenode(linebuf, 0);
+		oialtname->camefrom = findnamenode(line, 0);
 		oialtname->useinstead = NULL;
 
-		fgets_must(linebuf, sizeof(linebuf), file, vb.buf);
-		oicontest->useinstead = findnamenode(linebuf, 0);
+		line = divertdb_getline_must(&bufp, end, vb.buf);
+		oicontest->useinstead = findnamenode(line, 0);
 		oicontest->camefrom = NULL;
 
-		fgets_must(linebuf, sizeof(linebuf), file, vb.buf);
-		oicontest->pkg = oialtname->pkg = strcmp(linebuf, ":") ?
-		                                  findpackage(linebuf) : NULL;
+		line = divertdb_getline_must(&bufp, end, vb.buf);
+		oicontest->pkg = oialtname->pkg = strcmp(line, ":") ?
+		                                  findpackage(line) : NULL;
 
 		if (oialtname->camefrom->divert ||
 		    oicontest->useinstead->divert)
@@ -118,10 +200,11 @@ ensure_diversions(void)
 		oialtname->camefrom->divert = oicontest;
 		oicontest->useinstead->divert = oialtname;
 
-		oicontest->next = diversions;
-		diversions = oicontest;
+		divertdb_add(oicontest);
 	}
 
+	free(buf);
+
 	onerr_abort--;
 }
 
@@ -62,6 +62,14 @@ void print_error_perpackage(const char *emsg, const char *arg) {
 
   statusfd_send("status: %s : %s : %s", arg, "error", emsg);
 
+  statusfd_event_begin("error");
+  statusfd_event_string("package", arg);
+  statusfd_event_string("message", emsg);
+  statusfd_event_end();
+  statusfd_event_flush();
+
+  log_flush();
+
   nr= malloc(sizeof(struct error_report));
   if (!nr) {
     perror(_("dpkg: failed to allocate memory for new entry in list of failed packages."));
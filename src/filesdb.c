@@ -29,6 +29,9 @@
 #endif
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#endif
 
 #include <assert.h>
 #include <errno.h>
@@ -47,12 +50,14 @@
 #include <dpkg/buffer.h>
 #include <dpkg/pkg-array.h>
 #include <dpkg/progress.h>
+#include <dpkg/timing.h>
 
 #include "filesdb.h"
 #include "main.h"
 
 
-/* filepackages support for tracking packages owning a file. */
+/* filepackages support for tracking the packages owning a file besides
+ * the one in filenamenode.owner. */
 
 #define PERFILEPACKAGESLUMP 10
 
@@ -65,6 +70,7 @@ struct filepackages {
 };
 
 struct filepackages_iterator {
+  struct pkginfo *owner;
   struct filepackages *pkg_lump;
   int pkg_idx;
 };
@@ -75,6 +81,7 @@ filepackages_iter_new(struct filenamenode *fnn)
   struct filepackages_iterator *iter;
 
   iter = m_malloc(sizeof(*iter));
+  iter->owner = fnn->owner;
   iter->pkg_lump  = fnn->packages;
   iter->pkg_idx = 0;
 
@@ -86,10 +93,15 @@ filepackages_iter_next(struct filepackages_iterator *iter)
 {
   struct pkginfo *pkg;
 
-  while (iter->pkg_lump) {
-    pkg = iter->pkg_lump->pkgs[iter->pkg_idx];
+  if (iter->owner) {
+    pkg = iter->owner;
+    iter->owner = NULL;
+    return pkg;
+  }
 
-    if (iter->pkg_idx < PERFILEPACKAGESLUMP && pkg) {
+  while (iter->pkg_lump) {
+    if (iter->pkg_idx < PERFILEPACKAGESLUMP &&
+        (pkg = iter->pkg_lump->pkgs[iter->pkg_idx])) {
       iter->pkg_idx++;
       return pkg;
     } else {
@@ -120,6 +132,7 @@ ensure_package_clientdata(struct pkginfo *pkg)
   pkg->clientdata = nfmalloc(sizeof(struct perpackagestate));
   pkg->clientdata->istobe = itb_normal;
   pkg->clientdata->color = white;
+  pkg->clientdata->queuenode = -1;
   pkg->clientdata->fileslistvalid = false;
   pkg->clientdata->files = NULL;
   pkg->clientdata->listfile_phys_offs = 0;
@@ -134,6 +147,36 @@ void note_must_reread_files_inpackage(struct pkginfo *pkg) {
 
 static int saidread=0;
 
+/**
+ * Take any one package out of the packages lumps of a file.
+ *
+ * @return The package, or NULL if there was none.
+ */
+static struct pkginfo *
+filepackages_pop(struct filenamenode *namenode)
+{
+  struct filepackages *packageslump;
+  struct pkginfo *pkg;
+  int last;
+
+  for (packageslump = namenode->packages;
+       packageslump;
+       packageslump = packageslump->more) {
+    for (last = 0;
+         last < PERFILEPACKAGESLUMP && packageslump->pkgs[last];
+         last++);
+    if (last == 0)
+      continue;
+
+    pkg = packageslump->pkgs[last - 1];
+    packageslump->pkgs[last - 1] = NULL;
+
+    return pkg;
+  }
+
+  return NULL;
+}
+
 /**
  * Erase the files saved in pkg.
  */
@@ -141,6 +184,7 @@ static void
 pkg_files_blank(struct pkginfo *pkg)
 {
   struct fileinlist *current;
+  struct filenamenode *namenode;
   struct filepackages *packageslump;
   int search, findlast;
 
@@ -151,11 +195,21 @@ pkg_files_blank(struct pkginfo *pkg)
   for (current= pkg->clientdata->files;
        current;
        current= current->next) {
+    namenode = current->namenode;
+
+    /* If the package is the inline owner, move another owner in its
+     * place, so that there are only other owners if there is an inline
+     * one; we then remove that one from the lumps instead. */
+    if (namenode->owner == pkg) {
+      namenode->owner = filepackages_pop(namenode);
+      continue;
+    }
+
     /* For each file that used to be in the package,
      * go through looking for this package's entry in the list
      * of packages containing this file, and blank it out.
      */
-    for (packageslump= current->namenode->packages;
+    for (packageslump= namenode->packages;
          packageslump;
          packageslump= packageslump->more)
       for (search= 0;
@@ -211,7 +265,12 @@ pkg_files_add_file(struct pkginfo *pkg, const char *filename,
   *file_tail = newent;
   file_tail = &newent->next;
 
-  /* Add pkg to newent's package list. */
+  /* Add pkg to newent's package list, most files only get one. */
+  if (!newent->namenode->owner) {
+    newent->namenode->owner = pkg;
+    return file_tail;
+  }
+
   packageslump = newent->namenode->packages;
   putat = 0;
   if (packageslump) {
@@ -319,6 +378,150 @@ ensure_packagefiles_available(struct pkginfo *pkg)
   pkg->clientdata->fileslistvalid = true;
 }
 
+/*
+ * Read-only streaming access to the files list of a package.
+ *
+ * This is meant for callers that only want to go once through the list
+ * of a single package, like dpkg-query --listfiles. Unlike with
+ * ensure_packagefiles_available(), the file names are not added to the
+ * files database, so nothing gets allocated per file.
+ */
+struct filelist_stream {
+  struct pkginfo *pkg;
+  char *data;
+  size_t size;
+  const char *cur, *end;
+  struct varbuf name;
+};
+
+static void
+filelist_stream_free(struct filelist_stream *fls)
+{
+  if (fls->data) {
+#ifdef USE_MMAP
+    munmap(fls->data, fls->size);
+#else
+    free(fls->data);
+#endif
+  }
+  varbuf_destroy(&fls->name);
+  free(fls);
+}
+
+static void
+cu_filelist_stream_free(int argc, void **argv)
+{
+  filelist_stream_free(argv[0]);
+}
+
+struct filelist_stream *
+filelist_stream_open(struct pkginfo *pkg)
+{
+  struct filelist_stream *fls;
+  const char *filelistfile;
+  struct stat stat_buf;
+  char *data;
+  int fd;
+
+  if (pkg->status == stat_notinstalled)
+    return NULL;
+
+  filelistfile = pkgadminfile(pkg, LISTFILE);
+
+  fd = open(filelistfile, O_RDONLY);
+  if (fd == -1) {
+    if (errno != ENOENT)
+      ohshite(_("unable to open files list file for package `%.250s'"),
+              pkg->name);
+    if (pkg->status != stat_configfiles)
+      warning(_("files list file for package `%.250s' missing, assuming "
+                "package has no files currently installed."), pkg->name);
+    return NULL;
+  }
+
+  fls = m_malloc(sizeof(*fls));
+  fls->pkg = pkg;
+  fls->size = 0;
+  fls->data = NULL;
+  varbufinit(&fls->name, 0);
+
+  /* Popped by filelist_stream_close(). */
+  push_cleanup(cu_filelist_stream_free, ehflag_bombout, NULL, 0, 1, fls);
+  push_cleanup(cu_closefd, ehflag_bombout, NULL, 0, 1, &fd);
+
+  if (fstat(fd, &stat_buf))
+    ohshite(_("unable to stat files list file for package '%.250s'"),
+            pkg->name);
+
+  if (stat_buf.st_size) {
+#ifdef USE_MMAP
+    data = mmap(NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+      ohshite(_("unable to mmap files list file for package '%.250s'"),
+              pkg->name);
+#else
+    data = m_malloc(stat_buf.st_size);
+    fls->data = data;
+    fd_buf_copy(fd, data, stat_buf.st_size,
+                _("files list for package `%.250s'"), pkg->name);
+#endif
+    fls->data = data;
+    fls->size = stat_buf.st_size;
+  }
+  fls->cur = fls->data;
+  fls->end = fls->data + fls->size;
+
+  pop_cleanup(ehflag_normaltidy); /* fd = open() */
+  if (close(fd))
+    ohshite(_("error closing files list file for package `%.250s'"),
+            pkg->name);
+
+  return fls;
+}
+
+/*
+ * Returns the next file name, normalized the same way as the names in
+ * the files database, or NULL at the end of the list. The name is only
+ * valid until the next call.
+ */
+const char *
+filelist_stream_next(struct filelist_stream *fls)
+{
+  const char *thisline, *ptr;
+
+  if (fls->cur >= fls->end)
+    return NULL;
+
+  thisline = fls->cur;
+  ptr = memchr(thisline, '\n', fls->end - thisline);
+  if (!ptr)
+    ohshit(_("files list file for package '%.250s' is missing final newline"),
+           fls->pkg->name);
+  fls->cur = ptr + 1;
+
+  /* Strip trailing "/". */
+  if (ptr > thisline && ptr[-1] == '/')
+    ptr--;
+  if (ptr == thisline)
+    ohshit(_("files list file for package `%.250s' contains empty filename"),
+           fls->pkg->name);
+
+  /* Like findnamenode(), use a single leading slash. */
+  varbufreset(&fls->name);
+  varbufaddc(&fls->name, '/');
+  varbufaddbuf(&fls->name, thisline, ptr - thisline);
+  varbufaddc(&fls->name, '\0');
+
+  return path_skip_slash_dotslash(fls->name.buf) - 1;
+}
+
+void
+filelist_stream_close(struct filelist_stream *fls)
+{
+  pop_cleanup(ehflag_normaltidy); /* Does not call cu_filelist_stream_free. */
+  filelist_stream_free(fls);
+}
+
 #if defined(HAVE_LINUX_FIEMAP_H)
 static int
 pkg_sorter_by_listfile_phys_offs(const void *a, const void *b)
@@ -418,6 +621,9 @@ void ensure_allinstfiles_available(void) {
   int i;
 
   if (allpackagesdone) return;
+
+  timing_start(timing_filesdb_load);
+
   if (saidread<2) {
     int max = countpackages();
 
@@ -446,6 +652,8 @@ void ensure_allinstfiles_available(void) {
     printf(_("%d files and directories currently installed.)\n"),nfiles);
     saidread=2;
   }
+
+  timing_stop(timing_filesdb_load);
 }
 
 void ensure_allinstfiles_available_quiet(void) {
@@ -460,8 +668,11 @@ write_filelist_except(struct pkginfo *pkg, struct fileinlist *list,
   /* If leaveout is nonzero, will not write any file whose filenamenode
    * has the fnnf_elide_other_lists flag set.
    */
-  static struct varbuf vb, newvb;
-  FILE *file;
+  static struct varbuf vb, newvb, listvb;
+  const char *buf;
+  size_t left;
+  ssize_t n;
+  int fd;
 
   varbufreset(&vb);
   varbufaddstr(&vb, pkgadmindir());
@@ -473,31 +684,45 @@ write_filelist_except(struct pkginfo *pkg, struct fileinlist *list,
   varbufaddstr(&newvb,vb.buf);
   varbufaddstr(&newvb,NEWDBEXT);
   varbufaddc(&newvb,0);
-  
-  file= fopen(newvb.buf,"w+");
-  if (!file)
-    ohshite(_("unable to create updated files list file for package %s"),pkg->name);
-  push_cleanup(cu_closefile, ehflag_bombout, NULL, 0, 1, (void *)file);
+
+  /* Build the whole list in memory, so that it takes a single write. */
+  varbufreset(&listvb);
   while (list) {
     if (!(leaveout && (list->namenode->flags & fnnf_elide_other_lists))) {
-      fputs(list->namenode->name,file);
-      putc('\n',file);
+      varbufaddstr(&listvb, list->namenode->name);
+      varbufaddc(&listvb, '\n');
     }
     list= list->next;
   }
-  if (ferror(file))
-    ohshite(_("failed to write to updated files list file for package %s"),pkg->name);
-  if (fflush(file))
-    ohshite(_("failed to flush updated files list file for package %s"),pkg->name);
-  if (fsync(fileno(file)))
+
+  fd = open(newvb.buf, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    ohshite(_("unable to create updated files list file for package %s"),pkg->name);
+  push_cleanup(cu_closefd, ehflag_bombout, NULL, 0, 1, &fd);
+  for (buf = listvb.buf, left = listvb.used; left; buf += n, left -= n) {
+    n = write(fd, buf, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        n = 0;
+        continue;
+      }
+      ohshite(_("failed to write to updated files list file for package %s"),pkg->name);
+    }
+  }
+  timing_count(timing_fsync);
+  if (fsync(fd))
     ohshite(_("failed to sync updated files list file for package %s"),pkg->name);
-  pop_cleanup(ehflag_normaltidy); /* file= fopen() */
-  if (fclose(file))
+  pop_cleanup(ehflag_normaltidy); /* fd= open() */
+  if (close(fd))
     ohshite(_("failed to close updated files list file for package %s"),pkg->name);
+  timing_count(timing_rename);
   if (rename(newvb.buf,vb.buf))
     ohshite(_("failed to install updated files list file for package %s"),pkg->name);
 
-  dir_sync_path(pkgadmindir());
+  /* The directory gets synced before the next status update, which is
+   * what commits the new list, so that the lists of all the packages
+   * changed in one go only cost a single sync. */
+  dir_sync_path_deferred(pkgadmindir());
 
   note_must_reread_files_inpackage(pkg);
 }
@@ -507,32 +732,28 @@ void reversefilelist_init(struct reversefilelistiter *iterptr,
   /* Initialises an iterator that appears to go through the file
    * list `files' in reverse order, returning the namenode from
    * each.  What actually happens is that we walk the list here,
-   * building up a reverse list, and then peel it apart one
-   * entry at a time.
+   * taking note of the namenodes in a single array, and then hand
+   * them out from the end.
    */
-  struct fileinlist *newent;
-  
-  iterptr->todo = NULL;
-  while (files) {
-    newent= m_malloc(sizeof(struct fileinlist));
-    newent->namenode= files->namenode;
-    newent->next= iterptr->todo;
-    iterptr->todo= newent;
-    files= files->next;
-  }
+  struct fileinlist *file;
+  int n;
+
+  n = 0;
+  for (file = files; file; file = file->next)
+    n++;
+
+  iterptr->todo = n ? m_malloc(sizeof(*iterptr->todo) * n) : NULL;
+  iterptr->ntodo = 0;
+  for (file = files; file; file = file->next)
+    iterptr->todo[iterptr->ntodo++] = file->namenode;
 }
 
 struct filenamenode *reversefilelist_next(struct reversefilelistiter *iterptr) {
-  struct filenamenode *ret;
-  struct fileinlist *todo;
-
-  todo= iterptr->todo;
-  if (!todo)
+  if (!iterptr->ntodo) {
+    reversefilelist_abort(iterptr);
     return NULL;
-  ret= todo->namenode;
-  iterptr->todo= todo->next;
-  free(todo);
-  return ret;
+  }
+  return iterptr->todo[--iterptr->ntodo];
 }
 
 void reversefilelist_abort(struct reversefilelistiter *iterptr) {
@@ -541,7 +762,9 @@ void reversefilelist_abort(struct reversefilelistiter *iterptr) {
    * Calling this function is not necessary if reversefilelist_next has
    * been called until it returned 0.
    */
-  while (reversefilelist_next(iterptr));
+  free(iterptr->todo);
+  iterptr->todo = NULL;
+  iterptr->ntodo = 0;
 }
 
 struct fileiterator {
@@ -549,19 +772,40 @@ struct fileiterator {
   int nbinn;
 };
 
-#define BINS (1 << 17)
- /* This must always be a power of two.  If you change it
-  * consider changing the per-character hashing factor (currently
-  * 1785 = 137*13) too.
-  */
+/* The table starts small for the tools that only need a few nodes, and
+ * is doubled whenever there are more files than bins, reusing the hash
+ * cached in each node. The number of bins must always be a power of two. */
+#define BINS_MIN (1 << 12)
 
-static struct filenamenode *bins[BINS];
+static struct filenamenode **bins;
+static unsigned int nbins;
+static int iterators;
+
+/* Lookup statistics, for filesdb_hashreport(). */
+static unsigned long lookups, probes, maxprobes;
+
+static void
+iterfile_free(struct fileiterator *i)
+{
+  iterators--;
+  free(i);
+}
+
+static void
+cu_iterfile_free(int argc, void **argv)
+{
+  iterfile_free(argv[0]);
+}
 
 struct fileiterator *iterfilestart(void) {
   struct fileiterator *i;
   i= m_malloc(sizeof(struct fileiterator));
   i->namenode = NULL;
   i->nbinn= 0;
+  iterators++;
+  /* Otherwise an error would leave the table unable to grow. Popped by
+   * iterfileend(). */
+  push_cleanup(cu_iterfile_free, ehflag_bombout, NULL, 0, 1, i);
   return i;
 }
 
@@ -569,7 +813,7 @@ struct filenamenode *iterfilenext(struct fileiterator *i) {
   struct filenamenode *r= NULL;
 
   while (!i->namenode) {
-    if (i->nbinn >= BINS)
+    if (i->nbinn >= (int)nbins)
       return NULL;
     i->namenode= bins[i->nbinn++];
   }
@@ -579,14 +823,15 @@ struct filenamenode *iterfilenext(struct fileiterator *i) {
 }
 
 void iterfileend(struct fileiterator *i) {
-  free(i);
+  pop_cleanup(ehflag_normaltidy); /* Does not call cu_iterfile_free. */
+  iterfile_free(i);
 }
 
 void filesdbinit(void) {
   struct filenamenode *fnn;
-  int i;
+  unsigned int i;
 
-  for (i=0; i<BINS; i++)
+  for (i = 0; i < nbins; i++)
     for (fnn= bins[i]; fnn; fnn= fnn->next) {
       fnn->flags= 0;
       fnn->oldhash = NULL;
@@ -594,32 +839,75 @@ void filesdbinit(void) {
     }
 }
 
-static int hash(const char *name) {
-  int v= 0;
-  while (*name) { v *= 1787; v += *name; name++; }
-  return v;
+#define FNV_offset_basis 2166136261u
+#define FNV_mixing_prime 16777619u
+
+/* Fowler/Noll/Vo FNV-1a, which unlike the old multiplicative hash keeps
+ * the long common prefixes of paths from clustering in the low bits. */
+static unsigned int hash(const char *name) {
+  unsigned int h = FNV_offset_basis;
+
+  while (*name) {
+    h ^= (unsigned char)*name++;
+    h *= FNV_mixing_prime;
+  }
+
+  return h;
+}
+
+static void
+bins_resize(unsigned int newsize)
+{
+  struct filenamenode **newbins, *fnn, *next;
+  unsigned int i;
+
+  newbins = m_malloc(sizeof(*newbins) * newsize);
+  memset(newbins, 0, sizeof(*newbins) * newsize);
+
+  for (i = 0; i < nbins; i++)
+    for (fnn = bins[i]; fnn; fnn = next) {
+      next = fnn->next;
+      fnn->next = newbins[fnn->hash & (newsize - 1)];
+      newbins[fnn->hash & (newsize - 1)] = fnn;
+    }
+
+  free(bins);
+  bins = newbins;
+  nbins = newsize;
 }
 
 struct filenamenode *findnamenode(const char *name, enum fnnflags flags) {
   struct filenamenode **pointerp, *newnode;
   const char *orig_name = name;
+  unsigned int h;
+  unsigned long n = 0;
 
   /* We skip initial slashes and ./ pairs, and add our own single leading slash. */
   name = path_skip_slash_dotslash(name);
 
-  pointerp= bins + (hash(name) & (BINS-1));
+  if (!bins)
+    bins_resize(BINS_MIN);
+
+  h = hash(name);
+  pointerp= bins + (h & (nbins - 1));
   while (*pointerp) {
-/* Why is this assert nescessary?  It is checking already added entries. */
-    assert((*pointerp)->name[0] == '/');
-    if (!strcmp((*pointerp)->name+1,name)) break;
+    n++;
+    /* Only compare the names if the full hashes match. */
+    if ((*pointerp)->hash == h && !strcmp((*pointerp)->name + 1, name))
+      break;
     pointerp= &(*pointerp)->next;
   }
+  lookups++;
+  probes += n;
+  if (n > maxprobes)
+    maxprobes = n;
   if (*pointerp) return *pointerp;
 
   if (flags & fnn_nonew)
     return NULL;
 
   newnode= nfmalloc(sizeof(struct filenamenode));
+  newnode->owner = NULL;
   newnode->packages = NULL;
   if((flags & fnn_nocopy) && name > orig_name && name[-1] == '/')
     newnode->name = name - 1;
@@ -628,6 +916,7 @@ struct filenamenode *findnamenode(const char *name, enum fnnflags flags) {
     newname[0]= '/'; strcpy(newname+1,name);
     newnode->name= newname;
   }
+  newnode->hash = h;
   newnode->flags= 0;
   newnode->next = NULL;
   newnode->divert = NULL;
@@ -637,8 +926,44 @@ struct filenamenode *findnamenode(const char *name, enum fnnflags flags) {
   *pointerp= newnode;
   nfiles++;
 
+  /* Do not move nodes under the feet of an iterator. */
+  if ((unsigned int)nfiles > nbins && iterators == 0)
+    bins_resize(nbins * 2);
+
   return newnode;
 }
 
+void
+filesdb_hashreport(FILE *file)
+{
+  unsigned int i, c, maxc = 0, used = 0;
+  struct filenamenode *fnn;
+  int *freq;
+
+  freq = m_malloc(sizeof(int) * (nfiles + 1));
+  memset(freq, 0, sizeof(int) * (nfiles + 1));
+  for (i = 0; i < nbins; i++) {
+    for (c = 0, fnn = bins[i]; fnn; c++, fnn = fnn->next);
+    freq[c]++;
+    if (c)
+      used++;
+    if (c > maxc)
+      maxc = c;
+  }
+
+  fprintf(file, "files hash: %d files in %u bins, %u used\n",
+          nfiles, nbins, used);
+  for (c = 0; c <= maxc; c++)
+    fprintf(file, "files hash: chain length %5u occurs %7d times\n",
+            c, freq[c]);
+  fprintf(file, "files hash: %lu lookups, %.2f nodes probed on average, "
+          "%lu at most\n", lookups,
+          lookups ? (double)probes / lookups : 0.0, maxprobes);
+
+  m_output(file, "<hash report>");
+
+  free(freq);
+}
+
 /* vi: ts=8 sw=2
  */
@@ -55,6 +55,10 @@ enum fnnflags {
 struct filenamenode {
   struct filenamenode *next;
   const char *name;
+  /* The first package owning the file is kept inline, as that is the
+   * only one for most files; any others go into the packages lumps. If
+   * owner is NULL there are no owners at all. */
+  struct pkginfo *owner;
   struct filepackages *packages;
   struct diversion *divert;
   struct filestatoverride *statoverride;
@@ -73,6 +77,7 @@ struct filenamenode {
     fnnf_deferred_rename =    000400,
     fnnf_filtered =           001000, /* path being filtered */
   } flags; /* Set to zero when a new node is created. */
+  unsigned int hash; /* Of the name, kept across filesdbinit. */
   const char *oldhash; /* valid iff this namenode is in the newconffiles list */
   struct stat *filestat;
   struct trigfileint *trig_interested;
@@ -126,6 +131,7 @@ struct pkginfo *filepackages_iter_next(struct filepackages_iterator *i);
 void filepackages_iter_free(struct filepackages_iterator *i);
 
 void filesdbinit(void);
+void filesdb_hashreport(FILE *file);
 
 struct fileiterator;
 struct fileiterator *iterfilestart(void);
@@ -135,6 +141,9 @@ void iterfileend(struct fileiterator *i);
 void ensure_package_clientdata(struct pkginfo *pkg);
 
 void ensure_diversions(void);
+struct diversion *divertdb_first(void);
+void divertdb_add(struct diversion *contest);
+void divertdb_remove(struct diversion *contest);
 
 uid_t statdb_parse_uid(const char *str);
 gid_t statdb_parse_gid(const char *str);
@@ -144,6 +153,12 @@ void ensure_statoverrides(void);
 #define LISTFILE           "list"
 
 void ensure_packagefiles_available(struct pkginfo *pkg);
+
+struct filelist_stream;
+struct filelist_stream *filelist_stream_open(struct pkginfo *pkg);
+const char *filelist_stream_next(struct filelist_stream *fls);
+void filelist_stream_close(struct filelist_stream *fls);
+
 void ensure_allinstfiles_available(void);
 void ensure_allinstfiles_available_quiet(void);
 void note_must_reread_files_inpackage(struct pkginfo *pkg);
@@ -151,7 +166,10 @@ struct filenamenode *findnamenode(const char *filename, enum fnnflags flags);
 void write_filelist_except(struct pkginfo *pkg, struct fileinlist *list,
                            bool leaveout);
 
-struct reversefilelistiter { struct fileinlist *todo; };
+struct reversefilelistiter {
+  struct filenamenode **todo;
+  int ntodo;
+};
 
 void reversefilelist_init(struct reversefilelistiter *iterptr, struct fileinlist *files);
 struct filenamenode *reversefilelist_next(struct reversefilelistiter *iterptr);
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <string.h>
 #include <time.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -40,6 +41,8 @@
 #include <dpkg/subproc.h>
 #include <dpkg/command.h>
 #include <dpkg/triglib.h>
+#include <dpkg/timing.h>
+#include <dpkg/ugid.h>
 
 #include "filesdb.h"
 #include "main.h"
@@ -246,16 +249,39 @@ static void setexecute(const char *path, struct stat *stab) {
   ohshite(_("unable to set execute permissions on `%.250s'"),path);
 }
 
+/*
+ * Account for a maintainer script which has finished, started at start
+ * as returned by statusfd_event_clock(). The times of scripts running
+ * concurrently add up.
+ */
+static void
+script_done(struct pkginfo *pkg, const char *script, int status, double start)
+{
+  double seconds = statusfd_event_clock() - start;
+
+  timing_add(timing_maintscript, seconds);
+
+  statusfd_event_begin("script");
+  statusfd_event_string("package", pkg->name);
+  statusfd_event_string("script", script);
+  statusfd_event_integer("status", status);
+  statusfd_event_seconds("seconds", seconds);
+  statusfd_event_end();
+}
+
 static int
 do_script(struct pkginfo *pkg, struct pkginfoperfile *pif,
           struct command *cmd, struct stat *stab, int warn)
 {
   int c1, r;
+  double start;
 
   setexecute(cmd->filename, stab);
 
   push_cleanup(cu_post_script_tasks, ehflag_bombout, NULL, 0, 0);
 
+  start = statusfd_event_clock();
+
   c1 = subproc_fork();
   if (!c1) {
     if (setenv(MAINTSCRIPTPKGENVVAR, pkg->name, 1) ||
@@ -271,6 +297,11 @@ do_script(struct pkginfo *pkg, struct pkginfoperfile *pif,
   r = subproc_wait_check(c1, cmd->name, warn);
   pop_cleanup(ehflag_normaltidy);
 
+  script_done(pkg, cmd->argv[0], r, start);
+
+  /* The script might have added users or groups. */
+  ugid_cache_flush();
+
   pop_cleanup(ehflag_normaltidy);
 
   return r;
@@ -340,6 +371,90 @@ maintainer_script_postinst(struct pkginfo *pkg, ...)
   return r;
 }
 
+/*
+ * Start the installed postinst without waiting for it to finish.
+ *
+ * The script gets /dev/null as standard input and writes its standard
+ * output to out and its standard error to err, so that several of them
+ * can run at the same time without fighting over the terminal. The
+ * caller must hand the pid to maintainer_script_postinst_finish() once
+ * reaped, together with the statusfd_event_clock() value taken before
+ * starting it.
+ *
+ * Returns 0 if the package has no postinst.
+ */
+pid_t
+maintainer_script_postinst_start(struct pkginfo *pkg, int out, int err, ...)
+{
+  struct command cmd;
+  const char *scriptpath;
+  struct stat stab;
+  va_list args;
+  pid_t pid;
+  int fd;
+
+  scriptpath = pkgadminfile(pkg, POSTINSTFILE);
+  if (stat(scriptpath, &stab)) {
+    if (errno == ENOENT) {
+      debug(dbg_scripts, "maintainer_script_postinst_start nonexistent");
+      return 0;
+    }
+    ohshite(_("unable to stat %s `%.250s'"),
+            _("installed post-installation script"), scriptpath);
+  }
+  setexecute(scriptpath, &stab);
+
+  command_init(&cmd, scriptpath, _("installed post-installation script"));
+  command_add_arg(&cmd, POSTINSTFILE);
+  va_start(args, err);
+  command_add_argv(&cmd, args);
+  va_end(args);
+
+  pid = subproc_fork();
+  if (!pid) {
+    fd = open("/dev/null", O_RDONLY);
+    if (fd < 0 || dup2(fd, 0) < 0 || dup2(out, 1) < 0 || dup2(err, 2) < 0)
+      ohshite(_("unable to redirect maintainer script output"));
+    close(fd);
+    close(out);
+    close(err);
+
+    if (setenv(MAINTSCRIPTPKGENVVAR, pkg->name, 1) ||
+        setenv(MAINTSCRIPTARCHENVVAR, pkg->installed.architecture, 1) ||
+        setenv(MAINTSCRIPTNAMEENVVAR, cmd.argv[0], 1) ||
+        setenv(MAINTSCRIPTDPKGENVVAR, PACKAGE_VERSION, 1))
+      ohshite(_("unable to setenv for maintainer script"));
+
+    cmd.filename = cmd.argv[0] = preexecscript(&cmd);
+    command_exec(&cmd);
+  }
+  command_destroy(&cmd);
+
+  return pid;
+}
+
+/*
+ * Check the wait status of a postinst started with
+ * maintainer_script_postinst_start(), doing the same post script tasks
+ * as a synchronous run would.
+ */
+void
+maintainer_script_postinst_finish(struct pkginfo *pkg, int status,
+                                  double start)
+{
+  int r;
+
+  push_cleanup(cu_post_script_tasks, ehflag_bombout, NULL, 0, 0);
+  r = subproc_check(status, _("installed post-installation script"), 0);
+  pop_cleanup(ehflag_normaltidy);
+
+  script_done(pkg, POSTINSTFILE, r, start);
+
+  ugid_cache_flush();
+
+  ensure_diversions();
+}
+
 int
 maintainer_script_new(struct pkginfo *pkg,
                       const char *scriptname, const char *desc,
@@ -539,17 +654,24 @@ secure_unlink(const char *pathname)
 {
   struct stat stab;
 
+  timing_count(timing_lstat);
   if (lstat(pathname,&stab)) return -1;
 
   return secure_unlink_statted(pathname, &stab);
 }
 
+static bool
+secure_unlink_needs_chmod(const struct stat *stab)
+{
+  return S_ISREG(stab->st_mode) ? (stab->st_mode & 07000) :
+         !(S_ISLNK(stab->st_mode) || S_ISDIR(stab->st_mode) ||
+           S_ISFIFO(stab->st_mode) || S_ISSOCK(stab->st_mode));
+}
+
 int
 secure_unlink_statted(const char *pathname, const struct stat *stab)
 {
-  if (S_ISREG(stab->st_mode) ? (stab->st_mode & 07000) :
-      !(S_ISLNK(stab->st_mode) || S_ISDIR(stab->st_mode) ||
-	S_ISFIFO(stab->st_mode) || S_ISSOCK(stab->st_mode))) {
+  if (secure_unlink_needs_chmod(stab)) {
     if (chmod(pathname, 0600))
       return -1;
   }
@@ -557,6 +679,39 @@ secure_unlink_statted(const char *pathname, const struct stat *stab)
   return 0;
 }
 
+/* Same as secure_unlink, but with pathname relative to the directory
+ * open on dirfd, which can be AT_FDCWD. */
+int
+secure_unlinkat(int dirfd, const char *pathname)
+{
+  struct stat stab;
+
+  timing_count(timing_lstat);
+  if (fstatat(dirfd, pathname, &stab, AT_SYMLINK_NOFOLLOW))
+    return -1;
+  if (secure_unlink_needs_chmod(&stab)) {
+    if (fchmodat(dirfd, pathname, 0600, 0))
+      return -1;
+  }
+  if (unlinkat(dirfd, pathname, 0)) return -1;
+  return 0;
+}
+
+/* Same as ensure_pathname_nonexisting, but first check cheaply with name
+ * relative to dirfd whether there's anything to remove at all, which is
+ * by far the most common case. */
+void
+ensure_pathname_nonexisting_at(int dirfd, const char *name,
+                               const char *pathname)
+{
+  struct stat stab;
+
+  timing_count(timing_lstat);
+  if (fstatat(dirfd, name, &stab, AT_SYMLINK_NOFOLLOW) && errno == ENOENT)
+    return;
+  ensure_pathname_nonexisting(pathname);
+}
+
 void ensure_pathname_nonexisting(const char *pathname) {
   int c1;
   const char *u;
@@ -592,4 +747,10 @@ void log_action(const char *action, struct pkginfo *pkg) {
 	      versiondescribe(&pkg->installed.version, vdew_nonambig),
 	      versiondescribe(&pkg->available.version, vdew_nonambig));
   statusfd_send("processing: %s: %s", action, pkg->name);
+
+  statusfd_event_begin("processing");
+  statusfd_event_string("action", action);
+  statusfd_event_string("package", pkg->name);
+  statusfd_event_end();
+  statusfd_event_flush();
 }
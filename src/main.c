@@ -48,6 +48,8 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/command.h>
 #include <dpkg/myopt.h>
+#include <dpkg/ugid.h>
+#include <dpkg/timing.h>
 
 #include "main.h"
 #include "filesdb.h"
@@ -137,13 +139,16 @@ usage(const struct cmdinfo *ci, const char *value)
 "                             Just say what we would do - don't do it.\n"
 "  -D|--debug=<octal>         Enable debugging (see -Dhelp or --debug=help).\n"
 "  --status-fd <n>            Send status change updates to file descriptor <n>.\n"
+"  --status-event-fd <n>      Send structured status events to file descriptor <n>.\n"
 "  --log=<filename>           Log status changes and actions to <filename>.\n"
+"  --timing-log=<filename>    Append phase timings to <filename> as JSON.\n"
 "  --ignore-depends=<package>,...\n"
 "                             Ignore dependencies involving <package>.\n"
 "  --force-...                Override problems (see --force-help).\n"
 "  --no-force-...|--refuse-...\n"
 "                             Stop when problems encountered.\n"
 "  --abort-after <n>          Abort after encountering <n> errors.\n"
+"  --postinst-jobs <n>        Run up to <n> postinst scripts in parallel.\n"
 "\n"), ADMINDIR);
 
   printf(_(
@@ -187,8 +192,10 @@ int fc_conff_ask = 0;
 int fc_badverify = 0;
 
 int errabort = 50;
+int postinst_jobs_max = 1;
 const char *admindir= ADMINDIR;
 const char *instdir= "";
+static const char *timing_log = NULL;
 struct pkg_list *ignoredependss = NULL;
 
 static const struct forceinfo {
@@ -249,6 +256,7 @@ static void setdebug(const struct cmdinfo *cpi, const char *value) {
 "  10000   triggers          Trigger activation and processing\n"
 "  20000   triggersdetail    Lots of output regarding triggers\n"
 "  40000   triggersstupid    Silly amounts of output regarding triggers\n"
+" 100000   timing            Time spent in each phase and system call counts\n"
 "   1000   veryverbose       Lots of drivel about eg the dpkg/info directory\n"
 "   2000   stupidlyverbose   Insane amounts of drivel\n"
 "\n"
@@ -509,7 +517,9 @@ static const struct cmdinfo cmdinfos[]= {
   { "path-exclude",      0,   1, NULL,          NULL,      setfilter,     0 },
   { "path-include",      0,   1, NULL,          NULL,      setfilter,     1 },
   { "status-fd",         0,   1, NULL,          NULL,      setpipe, 0, &status_pipes },
+  { "status-event-fd",   0,   1, NULL,          NULL,      setpipe, 0, &status_event_pipes },
   { "log",               0,   1, NULL,          &log_file, NULL,    0 },
+  { "timing-log",        0,   1, NULL,          &timing_log, NULL,  0 },
   { "pending",           'a', 0, &f_pending,    NULL,      NULL,    1 },
   { "recursive",         'R', 0, &f_recursive,  NULL,      NULL,    1 },
   { "no-act",            0,   0, &f_noact,      NULL,      NULL,    1 },
@@ -527,6 +537,7 @@ static const struct cmdinfo cmdinfos[]= {
   { "auto-deconfigure",  'B', 0, &f_autodeconf, NULL,      NULL,    1 },
   { "root",              0,   1, NULL,          NULL,      setroot,       0 },
   { "abort-after",       0,   1, &errabort,     NULL,      setinteger,    0 },
+  { "postinst-jobs",     0,   1, &postinst_jobs_max, NULL, setinteger,    0 },
   { "admindir",          0,   1, NULL,          &admindir, NULL,          0 },
   { "instdir",           0,   1, NULL,          &instdir,  NULL,          0 },
   { "ignore-depends",    0,   1, NULL,          NULL,      ignoredepends, 0 },
@@ -680,6 +691,34 @@ void commandfd(const char *const *argv) {
 }
 
 
+static pid_t timing_pid;
+
+static void
+timing_report_atexit(void)
+{
+  FILE *file;
+
+  /* Forked children exiting without exec must not report again. */
+  if (getpid() != timing_pid)
+    return;
+
+  if (f_debug & dbg_timing)
+    timing_report(stderr);
+
+  if (timing_log) {
+    file = fopen(timing_log, "a");
+    if (!file) {
+      warning(_("could not open timing log file '%s': %s"), timing_log,
+              strerror(errno));
+      return;
+    }
+    timing_report_json(file, DPKG, cipaction->olong);
+    if (fclose(file))
+      warning(_("could not close timing log file '%s': %s"), timing_log,
+              strerror(errno));
+  }
+}
+
 int main(int argc, const char *const *argv) {
   jmp_buf ejbuf;
   void (*actionfunction)(const char *const *argv);
@@ -697,6 +736,15 @@ int main(int argc, const char *const *argv) {
   if (!f_triggers)
     f_triggers = (cipaction->arg == act_triggers && *argv) ? -1 : 1;
 
+  if ((f_debug & dbg_timing) || timing_log) {
+    timing_enable();
+    timing_pid = getpid();
+    atexit(timing_report_atexit);
+  }
+
+  if (status_event_pipes)
+    atexit(statusfd_event_flush);
+
   setvbuf(stdout, NULL, _IONBF, 0);
 
   if (is_invoke_action(cipaction->arg))
@@ -708,6 +756,11 @@ int main(int argc, const char *const *argv) {
 
   actionfunction(argv);
 
+  if (f_debug & dbg_veryverbose) {
+    filesdb_hashreport(stderr);
+    ugid_cache_report(stderr);
+  }
+
   if (is_invoke_action(cipaction->arg))
     run_invoke_hooks(cipaction->olong, post_invoke_hooks);
 
@@ -38,6 +38,9 @@ struct perpackagestate {
     black,
   } color;
 
+  /* Node number while ordering the processing queue, or -1. */
+  int queuenode;
+
   /*   filelistvalid   files         meaning
    *       0             0           not read yet, must do so if want them
    *       0            !=0          read, but rewritten and now out of
@@ -72,6 +75,7 @@ enum action {
 	act_listfiles,
 	act_searchfiles,
 	act_controlpath,
+	act_queryserver,
 
 	act_cmpversions,
 
@@ -134,6 +138,7 @@ extern int fc_badverify;
 
 extern bool abort_processing;
 extern int errabort;
+extern int postinst_jobs_max;
 extern const char *admindir;
 extern const char *instdir;
 extern struct pkg_list *ignoredependss;
@@ -190,6 +195,9 @@ int breakses_ok(struct pkginfo *pkg, struct varbuf *aemsgs);
 
 void deferred_remove(struct pkginfo *pkg);
 void deferred_configure(struct pkginfo *pkg);
+int postinst_jobs_running(void);
+void postinst_jobs_reap(bool block);
+void postinst_jobs_wait(void);
 
 extern int sincenothing, dependtry;
 
@@ -216,8 +224,11 @@ bool force_conff_miss(struct deppossi *possi);
 bool force_conflicts(struct deppossi *possi);
 void oldconffsetflags(const struct conffile *searchconff);
 void ensure_pathname_nonexisting(const char *pathname);
+void ensure_pathname_nonexisting_at(int dirfd, const char *name,
+                                    const char *pathname);
 int secure_unlink(const char *pathname);
 int secure_unlink_statted(const char *pathname, const struct stat *stab);
+int secure_unlinkat(int dirfd, const char *pathname);
 void checkpath(void);
 
 struct filenamenode *namenodetouse(struct filenamenode*, struct pkginfo*);
@@ -238,6 +249,10 @@ int maintainer_script_alternative(struct pkginfo *pkg,
  * trigger incorporation until after updating the package status. The effect
  * is that a package can trigger itself. */
 int maintainer_script_postinst(struct pkginfo *pkg, ...) DPKG_ATTR_SENTINEL;
+pid_t maintainer_script_postinst_start(struct pkginfo *pkg, int out, int err,
+                                       ...) DPKG_ATTR_SENTINEL;
+void maintainer_script_postinst_finish(struct pkginfo *pkg, int status,
+                                       double start);
 void post_postinst_tasks_core(struct pkginfo *pkg);
 
 void post_postinst_tasks(struct pkginfo *pkg, enum pkgstatus new_status);
@@ -260,6 +275,7 @@ enum debugflags {
   dbg_triggers =        010000,
   dbg_triggersdetail =  020000,
   dbg_triggersstupid =  040000,
+  dbg_timing =         0100000,
 };
   
 void debug(int which, const char *fmt, ...) DPKG_ATTR_PRINTF(2);
@@ -269,6 +285,7 @@ void log_action(const char *action, struct pkginfo *pkg);
 
 void trigproc_install_hooks(void);
 void trigproc_run_deferred(void);
+bool trigproc_defer(struct pkginfo *pkg);
 void trigproc_reset_cycle(void);
 
 /* Does cycle checking. Doesn't mind if pkg has no triggers
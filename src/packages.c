@@ -39,6 +39,7 @@
 #include <dpkg/pkg-list.h>
 #include <dpkg/pkg-queue.h>
 #include <dpkg/myopt.h>
+#include <dpkg/timing.h>
 
 #include "filesdb.h"
 #include "main.h"
@@ -149,6 +150,197 @@ packages(const char *const *argv)
   modstatdb_shutdown();
 }
 
+static void
+order_add_edge(int **edges, int *nedges, int *maxedges,
+               int from, struct pkginfo *to)
+{
+  if (!to->clientdata || to->clientdata->queuenode < 0 ||
+      to->clientdata->queuenode == from)
+    return;
+  if (*nedges == *maxedges) {
+    *maxedges *= 2;
+    *edges = m_realloc(*edges, sizeof(**edges) * *maxedges);
+  }
+  (*edges)[(*nedges)++] = to->clientdata->queuenode;
+}
+
+/* The order in which the nodes got finished by the depth-first search. */
+static int *order_finish;
+
+static int
+order_nodecmp(const void *a, const void *b)
+{
+  return order_finish[*(const int *)a] - order_finish[*(const int *)b];
+}
+
+/*
+ * Reorder the queue so that packages come after the queued packages they
+ * depend on, or before them when removing. We compute the strongly
+ * connected components of the [Pre-]Depends graph (including Provides)
+ * restricted to the queued packages with Tarjan's algorithm, which emits
+ * them in reverse topological order, in O(V+E). Packages in a cycle are
+ * put in the order the depth-first search finished them, so that they
+ * also come after their dependencies, except for the ones closing the
+ * cycle.
+ *
+ * This does not change which packages get processed or how, the
+ * dependtry escalation in process_queue() still takes care of cycles,
+ * trigger processing and the --force options, but it means most packages
+ * can be processed the first time they are popped, instead of going
+ * round the whole queue until their dependencies have been done.
+ */
+static void
+order_queue(bool reverse)
+{
+  struct pkg_list *rundown;
+  struct pkginfo **pkgs, *pkg;
+  struct dependency *dep;
+  struct deppossi *possi, *provider;
+  int *edgestart, *edges, nedges = 0, maxedges = 64;
+  int *index, *lowlink, *stack, *callnode, *calledge, *order, *compstart;
+  bool *onstack;
+  int n = 0, ncomp = 0, norder = 0, nstack = 0, ncall = 0, nindex = 0;
+  int nfinish = 0;
+  int i, u, v, e;
+
+  pkgs = m_malloc(sizeof(*pkgs) * (queue.length + 1));
+  for (rundown = queue.head; rundown; rundown = rundown->next) {
+    if (!rundown->pkg)
+      continue; /* duplicate, which we removed earlier */
+    rundown->pkg->clientdata->queuenode = n;
+    pkgs[n++] = rundown->pkg;
+  }
+  if (n < 2) {
+    for (i = 0; i < n; i++)
+      pkgs[i]->clientdata->queuenode = -1;
+    free(pkgs);
+    return;
+  }
+
+  /* Build the graph in compressed adjacency array form. */
+  edgestart = m_malloc(sizeof(*edgestart) * (n + 1));
+  edges = m_malloc(sizeof(*edges) * maxedges);
+  for (u = 0; u < n; u++) {
+    edgestart[u] = nedges;
+    for (dep = pkgs[u]->installed.depends; dep; dep = dep->next) {
+      if (dep->type != dep_depends && dep->type != dep_predepends)
+        continue;
+      for (possi = dep->list; possi; possi = possi->next) {
+        order_add_edge(&edges, &nedges, &maxedges, u, possi->ed);
+        /* Only look for providers of virtual packages, real packages
+         * can have very long lists of reverse dependencies. */
+        if (possi->verrel != dvr_none ||
+            possi->ed->status != stat_notinstalled)
+          continue;
+        for (provider = possi->ed->installed.depended; provider;
+             provider = provider->rev_next) {
+          if (provider->up->type != dep_provides)
+            continue;
+          order_add_edge(&edges, &nedges, &maxedges, u, provider->up->up);
+        }
+      }
+    }
+  }
+  edgestart[n] = nedges;
+
+  index = m_malloc(sizeof(*index) * n);
+  lowlink = m_malloc(sizeof(*lowlink) * n);
+  onstack = m_malloc(sizeof(*onstack) * n);
+  stack = m_malloc(sizeof(*stack) * n);
+  callnode = m_malloc(sizeof(*callnode) * n);
+  calledge = m_malloc(sizeof(*calledge) * n);
+  order = m_malloc(sizeof(*order) * n);
+  order_finish = m_malloc(sizeof(*order_finish) * n);
+  compstart = m_malloc(sizeof(*compstart) * (n + 1));
+  for (u = 0; u < n; u++) {
+    index[u] = -1;
+    onstack[u] = false;
+  }
+
+  /* Iterative version of Tarjan's algorithm, so that long dependency
+   * chains cannot exhaust the stack. */
+  for (i = 0; i < n; i++) {
+    if (index[i] >= 0)
+      continue;
+
+    index[i] = lowlink[i] = nindex++;
+    stack[nstack++] = i;
+    onstack[i] = true;
+    callnode[ncall] = i;
+    calledge[ncall++] = edgestart[i];
+
+    while (ncall) {
+      u = callnode[ncall - 1];
+      e = calledge[ncall - 1];
+
+      if (e < edgestart[u + 1]) {
+        calledge[ncall - 1]++;
+        v = edges[e];
+        if (index[v] < 0) {
+          index[v] = lowlink[v] = nindex++;
+          stack[nstack++] = v;
+          onstack[v] = true;
+          callnode[ncall] = v;
+          calledge[ncall++] = edgestart[v];
+        } else if (onstack[v] && index[v] < lowlink[u]) {
+          lowlink[u] = index[v];
+        }
+        continue;
+      }
+
+      ncall--;
+      order_finish[u] = nfinish++;
+      if (ncall && lowlink[u] < lowlink[callnode[ncall - 1]])
+        lowlink[callnode[ncall - 1]] = lowlink[u];
+
+      if (lowlink[u] != index[u])
+        continue;
+
+      /* The node is the root of a strongly connected component. */
+      compstart[ncomp++] = norder;
+      do {
+        v = stack[--nstack];
+        onstack[v] = false;
+        order[norder++] = v;
+      } while (v != u);
+      qsort(order + compstart[ncomp - 1], norder - compstart[ncomp - 1],
+            sizeof(*order), order_nodecmp);
+
+      if (norder - compstart[ncomp - 1] > 1)
+        debug(dbg_depcon, "dependency cycle of %d queued packages with %s",
+              norder - compstart[ncomp - 1], pkgs[u]->name);
+    }
+  }
+  compstart[ncomp] = norder;
+  assert(norder == n);
+
+  pkg_queue_destroy(&queue);
+  for (i = 0; i < ncomp; i++) {
+    int comp = reverse ? ncomp - 1 - i : i;
+
+    for (e = compstart[comp]; e < compstart[comp + 1]; e++) {
+      pkg = pkgs[order[reverse ? compstart[comp + 1] - 1 -
+                                 (e - compstart[comp]) : e]];
+      pkg->clientdata->queuenode = -1;
+      add_to_queue(pkg);
+    }
+  }
+
+  free(pkgs);
+  free(edgestart);
+  free(edges);
+  free(index);
+  free(lowlink);
+  free(onstack);
+  free(stack);
+  free(callnode);
+  free(calledge);
+  free(order);
+  free(order_finish);
+  order_finish = NULL;
+  free(compstart);
+}
+
 void process_queue(void) {
   struct pkg_list *rundown;
   struct pkginfo *volatile pkg;
@@ -191,8 +383,23 @@ void process_queue(void) {
       rundown->pkg->clientdata->istobe= istobe;
     }
   }
-  
-  while (!pkg_queue_is_empty(&queue)) {
+
+  timing_start(timing_order_queue);
+  order_queue(istobe == itb_remove);
+  timing_stop(timing_order_queue);
+
+  while (!pkg_queue_is_empty(&queue) || postinst_jobs_running()) {
+    /* Collect finished postinst jobs, waiting for one if there is no
+     * free slot or nothing else left to do. */
+    postinst_jobs_reap(postinst_jobs_running() >= postinst_jobs_max ||
+                       pkg_queue_is_empty(&queue));
+    if (abort_processing) {
+      postinst_jobs_wait();
+      return;
+    }
+    if (pkg_queue_is_empty(&queue))
+      continue;
+
     pkg = pkg_queue_pop(&queue);
     if (!pkg) continue; /* duplicate, which we removed earlier */
 
@@ -203,6 +410,12 @@ void process_queue(void) {
         add_to_queue(pkg);
         pkg = progress_bytrigproc;
         action_todo = act_configure;
+      } else if (postinst_jobs_running()) {
+        /* Everything left might be waiting on a running postinst. */
+        add_to_queue(pkg);
+        postinst_jobs_reap(true);
+        sincenothing = 0;
+        continue;
       } else {
         dependtry++;
         sincenothing = 0;
@@ -216,8 +429,10 @@ void process_queue(void) {
       /* give up on it from the point of view of other packages, ie reset istobe */
       pkg->clientdata->istobe= itb_normal;
       error_unwind(ehflag_bombout);
-      if (abort_processing)
+      if (abort_processing) {
+        postinst_jobs_wait();
         return;
+      }
       continue;
     }
     push_error_handler(&ejbuf,print_error_perpackage,pkg->name);
@@ -234,10 +449,17 @@ void process_queue(void) {
         break;
       /* Fall through. */
     case act_configure:
-      /* Do whatever is most needed. */
-      if (pkg->trigpend_head)
-        trigproc(pkg);
-      else
+      /* Do whatever is most needed. Trigger processing is postponed to
+       * the end of the run when configuring, so that activations made
+       * by the packages still to be configured get coalesced into it;
+       * anything blocked on it is handled through progress_bytrigproc. */
+      if (pkg->trigpend_head) {
+        if (action_todo == act_triggers || pkg == progress_bytrigproc ||
+            !trigproc_defer(pkg))
+          trigproc(pkg);
+        else
+          sincenothing = 0;
+      } else
         deferred_configure(pkg);
       break;
     case act_remove: case act_purge:
@@ -283,6 +505,11 @@ void process_queue(void) {
  * Depends lines.  In try 4 (only reached if --force-depends is set) we
  * say "ok" regardless.
  *
+ * Before starting, the queue is sorted so that packages come after the
+ * queued packages they depend on (or before them when removing), so that
+ * in the absence of cycles everything gets done during `try 1' without
+ * having to go round the queue more than once.
+ *
  * If we are configuring and one of the packages we depend on is
  * awaiting configuration but wasn't specified in the argument list we
  * will add it to the argument list if --configure-any is specified.
@@ -517,6 +744,7 @@ int dependencies_ok(struct pkginfo *pkg, struct pkginfo *removing,
   struct deppossi *possi, *provider;
   struct pkginfo *possfixbytrig, *canfixbytrig;
 
+  timing_count(timing_dependencies_ok);
   interestingwarnings= 0;
   ok= 2; /* 2=ok, 1=defer, 0=halt */
   debug(dbg_depcon,"checking dependencies of %s (- %s)",
@@ -45,6 +45,7 @@
 #include <dpkg/subproc.h>
 #include <dpkg/dir.h>
 #include <dpkg/tarfn.h>
+#include <dpkg/timing.h>
 #include <dpkg/myopt.h>
 #include <dpkg/triglib.h>
 
@@ -121,6 +122,7 @@ void process_archive(const char *filename) {
   struct filenamenode *namenode;
   struct dirent *de;
   struct stat stab, oldfs;
+  double extract_start;
   struct pkg_deconf_list *deconpil, *deconpiltemp;
   struct rename_list *rename_head = NULL, *rename_node = NULL;
   
@@ -629,8 +631,18 @@ void process_archive(const char *filename) {
   push_cleanup(cu_fileslist, ~0, NULL, 0, 0);
   tc.pkg= pkg;
   tc.backendpipe= p1[0];
-
+  tc.files = 0;
+  tc.bytes = 0;
+  extract_start = statusfd_event_clock();
+
+  /* The cleanups of the extracted objects get pushed on top of this one
+   * and stay there until the end of the package, so we cannot pop it.
+   * We close the directory cache ourselves once done with it instead,
+   * which turns this cleanup into a no-op. */
+  push_cleanup(cu_extractdirs, ~0, NULL, 0, 0);
+  timing_start(timing_tar_extract);
   r = tar_extractor(&tc, &tf);
+  timing_stop(timing_tar_extract);
   if (r) {
     if (errno) {
       ohshite(_("error reading dpkg-deb tar output"));
@@ -643,7 +655,18 @@ void process_archive(const char *filename) {
   p1[0] = -1;
   subproc_wait_check(c1, BACKEND " --fsys-tarfile", PROCPIPE);
 
+  timing_start(timing_tar_deferred_extract);
   tar_deferred_extract(newfileslist, pkg);
+  timing_stop(timing_tar_deferred_extract);
+
+  statusfd_event_begin("unpack");
+  statusfd_event_string("package", pkg->name);
+  statusfd_event_integer("files", tc.files);
+  statusfd_event_integer("bytes", tc.bytes);
+  statusfd_event_seconds("seconds", statusfd_event_clock() - extract_start);
+  statusfd_event_end();
+  statusfd_event_flush();
+  extractdirs_close();
 
   if (oldversionstatus == stat_halfinstalled || oldversionstatus == stat_unpacked) {
     /* Packages that were in `installed' and `postinstfailed' have been reduced
@@ -698,6 +721,7 @@ void process_archive(const char *filename) {
       if (isdirectoryinuse(namenode,pkg)) continue;
     }
 
+    timing_count(timing_lstat);
     if (lstat(fnamevb.buf, &oldfs)) {
       if (!(errno == ENOENT || errno == ELOOP || errno == ENOTDIR))
 	warning(_("could not stat old file '%.250s' so not deleting it: %s"),
@@ -967,6 +991,7 @@ void process_archive(const char *filename) {
       else
         blankversion(&newpossi->version);
       newpossi->cyclebreak = false;
+      newpossi->cache.valid = false;
       *newpossilastp= newpossi;
       newpossilastp= &newpossi->next;
     }
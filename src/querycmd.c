@@ -50,9 +50,31 @@
 
 #include "filesdb.h"
 #include "main.h"
+#include "querysrv.h"
 
 static const char* showformat		= "${Package}\t${Version}\n";
 
+/* Whether the query server has already loaded all the databases. */
+static bool db_preloaded = false;
+
+static void
+query_db_init(enum modstatdb_rw flags)
+{
+  if (db_preloaded)
+    return;
+
+  modstatdb_init(admindir, flags);
+}
+
+static void
+query_db_shutdown(void)
+{
+  if (db_preloaded)
+    return;
+
+  modstatdb_shutdown();
+}
+
 static int getwidth(void) {
   int fd;
   int res;
@@ -143,7 +165,7 @@ listpackages(const char *const *argv)
   int failures = 0;
   bool head;
 
-  modstatdb_init(admindir,msdbrw_readonly);
+  query_db_init(msdbrw_readonly);
 
   pkg_array_init_from_db(&array);
   pkg_array_sort(&array, pkg_sorter_by_name);
@@ -188,7 +210,7 @@ listpackages(const char *const *argv)
   m_output(stderr, _("<standard error>"));
 
   pkg_array_destroy(&array);
-  modstatdb_shutdown();
+  query_db_shutdown();
 
   return failures;
 }
@@ -229,6 +251,83 @@ static int searchoutput(struct filenamenode *namenode) {
   return found + (namenode->divert ? 1 : 0);
 }
 
+/*
+ * Most -S patterns are plain substrings, which get turned into "*foo*",
+ * or a path with a trailing or leading wildcard. Those can be matched
+ * with a simple string comparison instead of going through fnmatch() for
+ * every file in the database; for other globs the literal prefix is
+ * used to discard most of the names before calling fnmatch().
+ */
+struct search_pattern {
+  enum {
+    spt_substring,
+    spt_prefix,
+    spt_suffix,
+    spt_glob,
+  } type;
+  const char *glob;
+  const char *literal;
+  size_t len;
+};
+
+static void
+search_pattern_init(struct search_pattern *sp, struct varbuf *literal,
+                    const char *glob)
+{
+  const char *start, *end;
+  size_t lead, trail;
+
+  sp->glob = glob;
+
+  start = glob + strspn(glob, "*");
+  end = start + strcspn(start, "*?[\\");
+  lead = start - glob;
+  trail = strspn(end, "*");
+
+  if (end[trail] == '\0' && (lead || trail)) {
+    if (lead && trail)
+      sp->type = spt_substring;
+    else if (lead)
+      sp->type = spt_suffix;
+    else
+      sp->type = spt_prefix;
+  } else {
+    /* Only the part before the first wildcard is known. */
+    sp->type = spt_glob;
+    end = start = glob;
+    end += strcspn(glob, "*?[\\");
+  }
+
+  varbufreset(literal);
+  varbufaddbuf(literal, start, end - start);
+  varbufaddc(literal, '\0');
+  sp->literal = literal->buf;
+  sp->len = end - start;
+}
+
+static bool
+search_pattern_match(const struct search_pattern *sp, const char *name)
+{
+  size_t len;
+
+  switch (sp->type) {
+  case spt_substring:
+    return strstr(name, sp->literal) != NULL;
+  case spt_prefix:
+    return strncmp(name, sp->literal, sp->len) == 0;
+  case spt_suffix:
+    len = strlen(name);
+    return len >= sp->len &&
+           memcmp(name + len - sp->len, sp->literal, sp->len) == 0;
+  case spt_glob:
+    if (strncmp(name, sp->literal, sp->len) != 0)
+      return false;
+    return fnmatch(sp->glob, name, 0) == 0;
+  default:
+    internerr("unknown search pattern type '%d'", sp->type);
+  }
+}
+
 static int
 searchfiles(const char *const *argv)
 {
@@ -238,12 +337,14 @@ searchfiles(const char *const *argv)
   int found;
   int failures = 0;
   struct varbuf path = VARBUF_INIT;
+  struct varbuf literal = VARBUF_INIT;
+  struct search_pattern sp;
   static struct varbuf vb;
   
   if (!*argv)
     badusage(_("--search needs at least one file name pattern argument"));
 
-  modstatdb_init(admindir,msdbrw_readonly|msdbrw_noavail);
+  query_db_init(msdbrw_readonly|msdbrw_noavail);
   ensure_allinstfiles_available_quiet();
   ensure_diversions();
 
@@ -275,9 +376,15 @@ searchfiles(const char *const *argv)
       namenode= findnamenode(thisarg, 0);
       found += searchoutput(namenode);
     } else {
+      search_pattern_init(&sp, &literal, thisarg);
+
       it= iterfilestart();
       while ((namenode = iterfilenext(it)) != NULL) {
-        if (fnmatch(thisarg,namenode->name,0)) continue;
+        /* Nodes with neither packages nor diversions print nothing. */
+        if (!namenode->owner && !namenode->divert)
+          continue;
+        if (!search_pattern_match(&sp, namenode->name))
+          continue;
         found+= searchoutput(namenode);
       }
       iterfileend(it);
@@ -290,9 +397,10 @@ searchfiles(const char *const *argv)
       m_output(stdout, _("<standard output>"));
     }
   }
-  modstatdb_shutdown();
+  query_db_shutdown();
 
   varbuf_destroy(&path);
+  varbuf_destroy(&literal);
 
   return failures;
 }
@@ -301,7 +409,8 @@ static int
 enqperpackage(const char *const *argv)
 {
   const char *thisarg;
-  struct fileinlist *file;
+  struct filelist_stream *fls;
+  const char *name;
   struct pkginfo *pkg;
   struct filenamenode *namenode;
   int failures = 0;
@@ -310,9 +419,9 @@ enqperpackage(const char *const *argv)
     badusage(_("--%s needs at least one package name argument"), cipaction->olong);
 
   if (cipaction->arg==act_listfiles)
-    modstatdb_init(admindir,msdbrw_readonly|msdbrw_noavail);
+    query_db_init(msdbrw_readonly|msdbrw_noavail);
   else 
-    modstatdb_init(admindir,msdbrw_readonly);
+    query_db_init(msdbrw_readonly);
 
   while ((thisarg = *argv++) != NULL) {
     pkg= findpackage(thisarg);
@@ -350,16 +459,19 @@ enqperpackage(const char *const *argv)
         break;
         
       default:
-        ensure_packagefiles_available(pkg);
         ensure_diversions();
-        file= pkg->clientdata->files;
-        if (!file) {
+        /* Stream the list, so that only the diverted files, which are
+         * already in the files database, need a node. */
+        fls = filelist_stream_open(pkg);
+        name = fls ? filelist_stream_next(fls) : NULL;
+        if (!name) {
           printf(_("Package `%s' does not contain any files (!)\n"),pkg->name);
         } else {
-          while (file) {
-            namenode= file->namenode;
-            puts(namenode->name);
-            if (namenode->divert && !namenode->divert->camefrom) {
+          while (name) {
+            puts(name);
+            namenode = findnamenode(name, fnn_nonew);
+            if (namenode && namenode->divert &&
+                !namenode->divert->camefrom) {
               if (!namenode->divert->pkg)
 		printf(_("locally diverted to: %s\n"),
 		       namenode->divert->useinstead->name);
@@ -371,9 +483,11 @@ enqperpackage(const char *const *argv)
 		       namenode->divert->pkg->name,
 		       namenode->divert->useinstead->name);
             }
-            file= file->next;
+            name = filelist_stream_next(fls);
           }
         }
+        if (fls)
+          filelist_stream_close(fls);
         break;
       }
       break;
@@ -393,7 +507,7 @@ enqperpackage(const char *const *argv)
          "and dpkg --contents (= dpkg-deb --contents) to list their contents.\n"),stderr);
     m_output(stderr, _("<standard error>"));
   }
-  modstatdb_shutdown();
+  query_db_shutdown();
 
   return failures;
 }
@@ -412,7 +526,7 @@ showpackages(const char *const *argv)
     return failures;
   }
 
-  modstatdb_init(admindir,msdbrw_readonly);
+  query_db_init(msdbrw_readonly);
 
   pkg_array_init_from_db(&array);
   pkg_array_sort(&array, pkg_sorter_by_name);
@@ -456,7 +570,7 @@ showpackages(const char *const *argv)
 
   pkg_array_destroy(&array);
   pkg_format_free(fmt);
-  modstatdb_shutdown();
+  query_db_shutdown();
 
   return failures;
 }
@@ -565,7 +679,7 @@ control_path(const char *const *argv)
         badusage(_("control file contains %c"), *c);
   }
 
-  modstatdb_init(admindir, msdbrw_readonly | msdbrw_noavail);
+  query_db_init(msdbrw_readonly | msdbrw_noavail);
 
   pkg = findpackage(pkg_name);
   if (pkg->status == stat_notinstalled)
@@ -576,11 +690,22 @@ control_path(const char *const *argv)
   else
     control_path_pkg(pkg);
 
-  modstatdb_shutdown();
+  query_db_shutdown();
 
   return 0;
 }
 
+static int query_server_request(const char *const *argv);
+
+static int
+query_server_start(const char *const *argv)
+{
+  if (*argv)
+    badusage(_("--%s takes no arguments"), cipaction->olong);
+
+  query_server(query_server_request);
+}
+
 static void DPKG_ATTR_NORET
 printversion(const struct cmdinfo *ci, const char *value)
 {
@@ -612,6 +737,7 @@ usage(const struct cmdinfo *ci, const char *value)
 "  -S|--search <pattern> ...        Find package(s) owning file(s).\n"
 "  -c|--control-path <package> [<file>]\n"
 "                                   Print path for package control file.\n"
+"  --serve                          Serve queries from memory on a socket.\n"
 "\n"));
 
   printf(_(
@@ -670,6 +796,7 @@ static const struct cmdinfo cmdinfos[]= {
   ACTION( "search",                         'S', act_searchfiles,   searchfiles     ),
   ACTION( "show",                           'W', act_listpackages,  showpackages    ),
   ACTION( "control-path",                   'c', act_controlpath,   control_path    ),
+  ACTION( "serve",                          0,   act_queryserver,   query_server_start ),
 
   { "admindir",   0,   1, NULL, &admindir,   NULL          },
   { "showformat", 'f', 1, NULL, &showformat, NULL          },
@@ -678,9 +805,36 @@ static const struct cmdinfo cmdinfos[]= {
   {  NULL,        0,   0, NULL, NULL,        NULL          }
 };
 
+/**
+ * Run a query passed on to the query server, with the databases already
+ * in memory.
+ */
+static int
+query_server_request(const char *const *argv)
+{
+  int (*actionfunction)(const char *const *argv);
+
+  db_preloaded = true;
+  cipaction = NULL;
+
+  myopt(&argv, cmdinfos);
+
+  if (!cipaction) badusage(_("need an action option"));
+  if (cipaction->arg == act_queryserver)
+    badusage(_("--%s cannot be requested from the query server"),
+             cipaction->olong);
+
+  actionfunction = (int (*)(const char *const *))cipaction->farg;
+
+  return !!actionfunction(argv);
+}
+
 int main(int argc, const char *const *argv) {
   jmp_buf ejbuf;
   int (*actionfunction)(const char *const *argv);
+  const char *const *args = argv + 1;
+  char columns[20];
+  int width;
   int ret;
 
   setlocale(LC_ALL, "");
@@ -692,6 +846,20 @@ int main(int argc, const char *const *argv) {
 
   if (!cipaction) badusage(_("need an action option"));
 
+  if (cipaction->arg != act_queryserver) {
+    /* The server has no terminal to get the width from. */
+    if (!getenv("COLUMNS") && (width = getwidth()) > 0) {
+      sprintf(columns, "%d", width);
+      setenv("COLUMNS", columns, 1);
+    }
+
+    ret = query_client(args);
+    if (ret >= 0) {
+      standard_shutdown();
+      return ret;
+    }
+  }
+
   setvbuf(stdout, NULL, _IONBF, 0);
   filesdbinit();
 
@@ -0,0 +1,746 @@
+/*
+ * dpkg-query - program for query the dpkg database
+ * querysrv.c - serve queries from databases kept in memory
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <compat.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#if HAVE_LOCALE_H
+#include <locale.h>
+#endif
+#include <errno.h>
+#include <ctype.h>
+#include <string.h>
+#include <grp.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <dpkg/i18n.h>
+#include <dpkg/dpkg.h>
+#include <dpkg/dpkg-db.h>
+#include <dpkg/pkg-array.h>
+#include <dpkg/subproc.h>
+
+#include "filesdb.h"
+#include "main.h"
+#include "querysrv.h"
+
+/*
+ * The server listens on a socket in the admin directory. A client sends
+ * a 32-bit request length in host byte order, carrying its standard
+ * output and error as SCM_RIGHTS, followed by the request itself: a
+ * list of NUL-terminated strings with the environment variables to use,
+ * an empty string, and the command line arguments. For each connection
+ * the server forks a process, which already has the databases loaded.
+ * This process reads the request, switches to the user and group of the
+ * client, and replies with a single byte to accept the request. The
+ * client confirms it still wants the request served with a single byte
+ * too, and only then does the server run the command with its output
+ * going straight to the client descriptors. It then replies with a
+ * single byte containing the exit status. Until the request has been
+ * confirmed nothing has been output, so the client can still run the
+ * query on its own if the server is not responsive, after closing the
+ * connection so that a late server drops the request instead.
+ *
+ * The databases are loaded by a worker process, which checks before
+ * accepting each connection whether they have changed on disk. Changes
+ * to the diversions and to the files lists of some packages get merged
+ * in place, anything else makes the worker exit, leaving the connection
+ * pending for a new one to be forked with freshly loaded databases.
+ */
+
+#define QUERY_REQUEST_MAX (1024 * 1024)
+#define QUERY_REQUEST_TIMEOUT 10
+#define QUERY_ACCEPT_TIMEOUT 5
+
+/* Only these variables are passed from the client, to get the same
+ * output it would have produced on its own. */
+static const char *const query_env[] = {
+  "COLUMNS",
+  "LANGUAGE",
+  "LC_ALL",
+  "LC_CTYPE",
+  "LC_MESSAGES",
+  "LANG",
+  NULL
+};
+
+static bool
+query_socket_addr(struct sockaddr_un *sa)
+{
+  int n;
+
+  memset(sa, 0, sizeof(*sa));
+  sa->sun_family = AF_UNIX;
+  n = snprintf(sa->sun_path, sizeof(sa->sun_path), "%s/%s",
+               admindir, QUERYSOCKETFILE);
+
+  return n >= 0 && n < (int)sizeof(sa->sun_path);
+}
+
+/*
+ * The locale variables are used by the request process to find message
+ * catalogs, so only accept values looking like locale names, and never
+ * anything which could be taken as a path.
+ */
+static bool
+query_env_value_valid(const char *name, const char *value)
+{
+  const char *p;
+
+  if (strcmp(name, "COLUMNS") == 0)
+    return strspn(value, "0123456789") == strlen(value);
+
+  if (value[0] == '.')
+    return false;
+
+  for (p = value; *p; p++) {
+    if (isalnum((unsigned char)*p) || strchr("_-.@+", *p))
+      continue;
+    /* LANGUAGE is a colon-separated list of locale names. */
+    if (*p == ':' && strcmp(name, "LANGUAGE") == 0 && p[1] != '.')
+      continue;
+    return false;
+  }
+
+  return true;
+}
+
+static bool
+query_env_allowed(const char *var)
+{
+  const char *const *name;
+  size_t len;
+
+  for (name = query_env; *name; name++) {
+    len = strlen(*name);
+    if (strncmp(var, *name, len) == 0 && var[len] == '=')
+      return query_env_value_valid(*name, var + len + 1);
+  }
+
+  return false;
+}
+
+static bool
+query_send_all(int sock, const void *buf, size_t len)
+{
+  const char *p = buf;
+  ssize_t r;
+
+  while (len) {
+    r = send(sock, p, len, MSG_NOSIGNAL);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    len -= r;
+  }
+
+  return true;
+}
+
+static bool
+query_recv_all(int sock, void *buf, size_t len)
+{
+  char *p = buf;
+  ssize_t r;
+
+  while (len) {
+    r = recv(sock, p, len, 0);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    len -= r;
+  }
+
+  return true;
+}
+
+/**
+ * Run a query through the server, if there is one.
+ *
+ * @return The exit status of the query, or -1 if there was no server
+ *         willing to take the request, in which case the caller should
+ *         run it on its own.
+ */
+int
+query_client(const char *const *argv)
+{
+  struct sockaddr_un sa;
+  struct varbuf req = VARBUF_INIT;
+  const char *const *name;
+  const char *value;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * 2)];
+  } control;
+  int fds[2] = { 1, 2 };
+  struct pollfd pfd;
+  uint32_t len;
+  unsigned char status, go = 0;
+  int sock;
+  ssize_t r;
+
+  if (!query_socket_addr(&sa))
+    return -1;
+
+  sock = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    return -1;
+  if (connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    close(sock);
+    return -1;
+  }
+
+  for (name = query_env; *name; name++) {
+    value = getenv(*name);
+    if (!value)
+      continue;
+    varbufprintf(&req, "%s=%s", *name, value);
+    varbufaddc(&req, '\0');
+  }
+  varbufaddc(&req, '\0');
+  for (; *argv; argv++) {
+    varbufaddstr(&req, *argv);
+    varbufaddc(&req, '\0');
+  }
+  len = req.used;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &len;
+  iov.iov_len = sizeof(len);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  do {
+    r = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (r < 0 && errno == EINTR);
+
+  /* Nothing has been output yet, so we can still do it ourselves. */
+  if (r != sizeof(len) || !query_send_all(sock, req.buf, req.used)) {
+    varbuf_destroy(&req);
+    close(sock);
+    return -1;
+  }
+  varbuf_destroy(&req);
+
+  /* Nothing gets output before we confirm the request the server has
+   * accepted, so if it does not accept it, be it because it is busy or
+   * wedged, do it ourselves. Closing the connection first makes the
+   * server drop the request if it gets to accept it afterwards. */
+  pfd.fd = sock;
+  pfd.events = POLLIN;
+  do {
+    r = poll(&pfd, 1, QUERY_ACCEPT_TIMEOUT * 1000);
+  } while (r < 0 && errno == EINTR);
+  if (r > 0) {
+    do {
+      r = read(sock, &status, 1);
+    } while (r < 0 && errno == EINTR);
+  }
+  if (r <= 0 || !query_send_all(sock, &go, 1)) {
+    close(sock);
+    return -1;
+  }
+
+  do {
+    r = read(sock, &status, 1);
+  } while (r < 0 && errno == EINTR);
+  if (r < 0)
+    ohshite(_("unable to read reply from query server"));
+  if (r == 0)
+    ohshit(_("query server closed the connection without replying"));
+
+  close(sock);
+
+  return status;
+}
+
+/*** The request process ***/
+
+static int reply_sock;
+
+static void DPKG_ATTR_NORET
+query_request_exit(int status)
+{
+  unsigned char c = status;
+
+  query_send_all(reply_sock, &c, 1);
+
+  exit(status);
+}
+
+/**
+ * Get the credentials of the client. Returns false if they cannot be
+ * told, in which case the request must not be served.
+ */
+static bool
+query_peer_cred(int sock, uid_t *uid, gid_t *gid)
+{
+#ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+
+  if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+      len != sizeof(cred))
+    return false;
+
+  *uid = cred.uid;
+  *gid = cred.gid;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Run the request as the client, so that it cannot get at anything
+ * it could not have read by running the query on its own.
+ */
+static bool
+query_request_switch_user(uid_t uid, gid_t gid)
+{
+  if (uid == 0 || uid == geteuid())
+    return true;
+  if (geteuid() != 0)
+    return false;
+
+  return setgroups(1, &gid) == 0 && setgid(gid) == 0 && setuid(uid) == 0;
+}
+
+static void DPKG_ATTR_NORET
+query_request_run(int sock, int fds[2], char *req, size_t len,
+                  query_request_func *request)
+{
+  static jmp_buf ejbuf;
+  const char *const *name;
+  const char **argv;
+  unsigned char c = 0;
+  char *p, *end;
+  int argc;
+
+  m_dup2(fds[0], 1);
+  m_dup2(fds[1], 2);
+  close(fds[0]);
+  close(fds[1]);
+
+  for (name = query_env; *name; name++)
+    unsetenv(*name);
+
+  p = req;
+  end = req + len;
+  while (p < end && *p) {
+    if (query_env_allowed(p))
+      putenv(p);
+    p += strlen(p) + 1;
+  }
+  if (p < end)
+    p++;
+
+  /* The client might have given up waiting and be running the query
+   * on its own, so do not output anything until it confirms it wants
+   * us to. From then on the request is ours, and any failure gets
+   * reported. */
+  if (!query_send_all(sock, &c, 1) || !query_recv_all(sock, &c, 1))
+    exit(2);
+  reply_sock = sock;
+
+  if (setjmp(ejbuf)) {
+    error_unwind(ehflag_bombout);
+    query_request_exit(2);
+  }
+  push_error_handler(&ejbuf, print_error_fatal, NULL);
+
+  setlocale(LC_ALL, "");
+
+  /* Leave room for the program name, which the option parser skips. */
+  argc = 1;
+  for (end = p; end < req + len; end += strlen(end) + 1)
+    argc++;
+
+  argv = m_malloc(sizeof(*argv) * (argc + 1));
+  argc = 0;
+  argv[argc++] = thisname;
+  while (p < req + len) {
+    argv[argc++] = p;
+    p += strlen(p) + 1;
+  }
+  argv[argc] = NULL;
+
+  query_request_exit(request(argv));
+}
+
+/**
+ * Read and run a request, in a process of its own, so that a client
+ * taking its time to send it does not hold up the other ones. Any
+ * failure before the request is accepted just drops the connection.
+ */
+static void DPKG_ATTR_NORET
+query_request_serve(int listen_sock, int sock, query_request_func *request)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(sizeof(int) * 2)];
+  } control;
+  struct timeval timeout = { QUERY_REQUEST_TIMEOUT, 0 };
+  int fds[2] = { -1, -1 };
+  uint32_t len;
+  char *req;
+  uid_t uid;
+  gid_t gid;
+  ssize_t r;
+
+  close(listen_sock);
+  signal(SIGCHLD, SIG_DFL);
+
+  if (!query_peer_cred(sock, &uid, &gid) ||
+      !query_request_switch_user(uid, gid))
+    exit(2);
+
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &len;
+  iov.iov_len = sizeof(len);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  do {
+    r = recvmsg(sock, &msg, 0);
+  } while (r < 0 && errno == EINTR);
+  if (r != sizeof(len))
+    exit(2);
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+    exit(2);
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  if (len == 0 || len > QUERY_REQUEST_MAX)
+    exit(2);
+  req = m_malloc(len);
+  if (!query_recv_all(sock, req, len) || req[len - 1] != '\0')
+    exit(2);
+
+  query_request_run(sock, fds, req, len, request);
+}
+
+/*** The worker process ***/
+
+struct query_stamp {
+  bool exists;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+};
+
+static void
+query_stamp_get(struct query_stamp *qs, const char *filename)
+{
+  struct stat st;
+
+  memset(qs, 0, sizeof(*qs));
+
+  if (stat(filename, &st) < 0) {
+    if (errno != ENOENT)
+      ohshite(_("unable to stat `%.255s'"), filename);
+    return;
+  }
+
+  qs->exists = true;
+  qs->dev = st.st_dev;
+  qs->ino = st.st_ino;
+  qs->size = st.st_size;
+  qs->mtime = st.st_mtim;
+}
+
+/**
+ * Check whether a file has changed since it was last stamped, and
+ * stamp it again.
+ */
+static bool
+query_stamp_update(struct query_stamp *qs, const char *filename)
+{
+  struct query_stamp now;
+
+  query_stamp_get(&now, filename);
+
+  if (now.exists == qs->exists &&
+      now.dev == qs->dev && now.ino == qs->ino && now.size == qs->size &&
+      now.mtime.tv_sec == qs->mtime.tv_sec &&
+      now.mtime.tv_nsec == qs->mtime.tv_nsec)
+    return false;
+
+  *qs = now;
+
+  return true;
+}
+
+/* The files which, when changed, need the databases to be reloaded. */
+static const char *const query_db_files[] = {
+  STATUSFILE,
+  AVAILFILE,
+  UPDATESDIR,
+  TRIGGERSDIR TRIGGERSDEFERREDFILE,
+  NULL
+};
+
+static struct query_db {
+  struct varbuf path;
+  struct query_stamp files[array_count(query_db_files)];
+  struct query_stamp infodir;
+
+  struct pkg_array pkgs;
+  struct query_stamp *lists;
+} db;
+
+static const char *
+query_db_path(const char *file)
+{
+  varbufreset(&db.path);
+  varbufprintf(&db.path, "%s/%s", admindir, file);
+
+  return db.path.buf;
+}
+
+static void
+query_db_load(void)
+{
+  int i;
+
+  /* Stamp everything before reading it, so that any change done while
+   * we are at it gets noticed on the next request. */
+  for (i = 0; query_db_files[i]; i++)
+    query_stamp_get(&db.files[i], query_db_path(query_db_files[i]));
+  query_stamp_get(&db.infodir, query_db_path(INFODIR));
+
+  modstatdb_init(admindir, msdbrw_readonly);
+
+  pkg_array_init_from_db(&db.pkgs);
+  db.lists = m_malloc(sizeof(*db.lists) * db.pkgs.n_pkgs);
+  for (i = 0; i < db.pkgs.n_pkgs; i++)
+    query_stamp_get(&db.lists[i], pkgadminfile(db.pkgs.pkgs[i], LISTFILE));
+
+  ensure_allinstfiles_available_quiet();
+  ensure_diversions();
+}
+
+static bool
+query_db_changed(void)
+{
+  int i;
+
+  for (i = 0; query_db_files[i]; i++)
+    if (query_stamp_update(&db.files[i], query_db_path(query_db_files[i])))
+      return true;
+
+  return false;
+}
+
+/**
+ * Bring in the changes which do not need a full reload.
+ */
+static void
+query_db_refresh(void)
+{
+  struct pkginfo *pkg;
+  int i;
+
+  ensure_diversions();
+
+  /* The files lists are replaced by renaming new ones into place. */
+  if (!query_stamp_update(&db.infodir, query_db_path(INFODIR)))
+    return;
+
+  for (i = 0; i < db.pkgs.n_pkgs; i++) {
+    pkg = db.pkgs.pkgs[i];
+
+    if (query_stamp_update(&db.lists[i], pkgadminfile(pkg, LISTFILE)))
+      note_must_reread_files_inpackage(pkg);
+  }
+
+  ensure_allinstfiles_available_quiet();
+}
+
+static void DPKG_ATTR_NORET
+query_worker(int listen_sock, query_request_func *request)
+{
+  struct pollfd pfd;
+  pid_t pid;
+  int sock;
+
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGINT, SIG_DFL);
+  signal(SIGHUP, SIG_DFL);
+  /* Nobody waits for the request processes. */
+  signal(SIGCHLD, SIG_IGN);
+
+  query_db_load();
+
+  for (;;) {
+    pfd.fd = listen_sock;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      ohshite(_("unable to wait for query requests"));
+    }
+
+    if (query_db_changed())
+      exit(0);
+    query_db_refresh();
+
+    sock = accept(listen_sock, NULL, NULL);
+    if (sock < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      ohshite(_("unable to accept query request"));
+    }
+
+    /* The client falls back to direct access if we drop it. */
+    pid = fork();
+    if (pid < 0)
+      warning(_("unable to fork query request process: %s"),
+              strerror(errno));
+    else if (pid == 0)
+      query_request_serve(listen_sock, sock, request);
+    close(sock);
+  }
+}
+
+/*** The server process ***/
+
+static pid_t worker_pid;
+static struct sockaddr_un server_addr;
+
+static void
+cu_query_socket(int argc, void **argv)
+{
+  unlink(server_addr.sun_path);
+}
+
+static void
+query_server_signal(int sig)
+{
+  if (worker_pid > 0)
+    kill(worker_pid, SIGTERM);
+  unlink(server_addr.sun_path);
+
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+/**
+ * Serve queries on the socket in the admin directory until killed.
+ */
+void
+query_server(query_request_func *request)
+{
+  int sock;
+
+  if (!query_socket_addr(&server_addr))
+    ohshit(_("query server socket name `%.250s/%s' is too long"),
+           admindir, QUERYSOCKETFILE);
+
+  sock = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    ohshite(_("unable to create query server socket"));
+  setcloexec(sock, server_addr.sun_path);
+
+  if (bind(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+    if (errno != EADDRINUSE)
+      ohshite(_("unable to bind query server socket `%.250s'"),
+              server_addr.sun_path);
+
+    /* Only take over the socket if its server is gone. */
+    if (connect(sock, (struct sockaddr *)&server_addr,
+                sizeof(server_addr)) == 0)
+      ohshit(_("another query server is already running on `%.250s'"),
+             server_addr.sun_path);
+    close(sock);
+
+    sock = socket(PF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0)
+      ohshite(_("unable to create query server socket"));
+    setcloexec(sock, server_addr.sun_path);
+
+    if (unlink(server_addr.sun_path) < 0 ||
+        bind(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+      ohshite(_("unable to bind query server socket `%.250s'"),
+              server_addr.sun_path);
+  }
+  push_cleanup(cu_query_socket, ~0, NULL, 0, 0);
+
+  /* The databases are world readable, so let anyone ask. The requests
+   * get run with the credentials of the client. */
+  if (chmod(server_addr.sun_path, 0666) < 0)
+    ohshite(_("unable to set mode of query server socket `%.250s'"),
+            server_addr.sun_path);
+
+  if (listen(sock, SOMAXCONN) < 0)
+    ohshite(_("unable to listen on query server socket `%.250s'"),
+            server_addr.sun_path);
+
+  signal(SIGTERM, query_server_signal);
+  signal(SIGINT, query_server_signal);
+  signal(SIGHUP, query_server_signal);
+
+  /* The worker exits to get the databases reloaded. If it fails, keep
+   * going, but do not go into a busy loop if it keeps failing. */
+  for (;;) {
+    worker_pid = subproc_fork();
+    if (worker_pid == 0)
+      query_worker(sock, request);
+
+    if (subproc_wait_check(worker_pid, _("query server worker"), PROCWARN))
+      sleep(1);
+  }
+}
@@ -0,0 +1,36 @@
+/*
+ * dpkg-query - program for query the dpkg database
+ * querysrv.h - external definitions for the query server
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DPKG_QUERYSRV_H
+#define DPKG_QUERYSRV_H
+
+#include <dpkg/macros.h>
+
+DPKG_BEGIN_DECLS
+
+/* Runs a query from a full command line, returning its exit status. */
+typedef int query_request_func(const char *const *argv);
+
+int query_client(const char *const *argv);
+void query_server(query_request_func *request) DPKG_ATTR_NORET;
+
+DPKG_END_DECLS
+
+#endif
@@ -179,6 +179,18 @@ static void push_leftover(struct fileinlist **leftoverp,
   *leftoverp= newentry;
 }
 
+/* The objects of a package are removed relative to a descriptor of
+ * their parent directory, so that the kernel does not need to walk the
+ * whole pathname on each operation.  The file list is walked in reverse,
+ * which keeps the contents of a directory together. */
+static struct dir_cache removal_dirs;
+
+static void
+cu_removal_dirs(int argc, void **argv)
+{
+  dir_cache_close(&removal_dirs);
+}
+
 static void removal_bulk_remove_files(
     struct pkginfo *pkg, 
     bool *out_foundpostrm)
@@ -197,10 +209,14 @@ static void removal_bulk_remove_files(
     modstatdb_note(pkg);
     push_checkpoint(~ehflag_bombout, ehflag_normaltidy);
 
+    push_cleanup(cu_removal_dirs, ~0, NULL, 0, 0);
+
     reversefilelist_init(&rlistit,pkg->clientdata->files);
     leftover = NULL;
     while ((namenode= reversefilelist_next(&rlistit))) {
       struct filenamenode *usenode;
+      const char *name;
+      int dirfd;
 
       debug(dbg_eachfile, "removal_bulk `%s' flags=%o",
             namenode->name, namenode->flags);
@@ -221,17 +237,20 @@ static void removal_bulk_remove_files(
       varbufaddc(&fnvb,0);
       debug(dbg_eachfiledetail, "removal_bulk cleaning temp `%s'", fnvb.buf);
       
-      ensure_pathname_nonexisting(fnvb.buf);
+      dirfd = dir_cache_open(&removal_dirs, fnvb.buf, &name);
+      ensure_pathname_nonexisting_at(dirfd, name, fnvb.buf);
       
       varbuf_trunc(&fnvb, before);
       varbufaddstr(&fnvb,DPKGNEWEXT);
       varbufaddc(&fnvb,0);
       debug(dbg_eachfiledetail, "removal_bulk cleaning new `%s'", fnvb.buf);
-      ensure_pathname_nonexisting(fnvb.buf);
+      dirfd = dir_cache_open(&removal_dirs, fnvb.buf, &name);
+      ensure_pathname_nonexisting_at(dirfd, name, fnvb.buf);
       
       varbuf_trunc(&fnvb, before);
       varbufaddc(&fnvb,0);
-      if (!stat(fnvb.buf,&stab) && S_ISDIR(stab.st_mode)) {
+      dirfd = dir_cache_open(&removal_dirs, fnvb.buf, &name);
+      if (!fstatat(dirfd, name, &stab, 0) && S_ISDIR(stab.st_mode)) {
         debug(dbg_eachfiledetail, "removal_bulk is a directory");
         /* Only delete a directory or a link to one if we're the only
          * package which uses it.  Other files should only be listed
@@ -244,7 +263,9 @@ static void removal_bulk_remove_files(
 	if (isdirectoryinuse(namenode,pkg)) continue;
       }
       debug(dbg_eachfiledetail, "removal_bulk removing `%s'", fnvb.buf);
-      if (!rmdir(fnvb.buf) || errno == ENOENT || errno == ELOOP) continue;
+      if (!unlinkat(dirfd, name, AT_REMOVEDIR) ||
+          errno == ENOENT || errno == ELOOP)
+        continue;
       if (errno == ENOTEMPTY || errno == EEXIST) {
 	debug(dbg_eachfiledetail, "removal_bulk `%s' was not empty, will try again later",
 	      fnvb.buf);
@@ -259,9 +280,10 @@ static void removal_bulk_remove_files(
       }
       if (errno != ENOTDIR) ohshite(_("cannot remove `%.250s'"),fnvb.buf);
       debug(dbg_eachfiledetail, "removal_bulk unlinking `%s'", fnvb.buf);
-      if (secure_unlink(fnvb.buf))
+      if (secure_unlinkat(dirfd, name))
         ohshite(_("unable to securely remove '%.250s'"), fnvb.buf);
     }
+    pop_cleanup(ehflag_normaltidy); /* cu_removal_dirs */
     write_filelist_except(pkg,leftover,0);
     maintainer_script_installed(pkg, POSTRMFILE, "post-removal",
                                 "remove", NULL);
@@ -320,10 +342,14 @@ static void removal_bulk_remove_leftover_dirs(struct pkginfo *pkg) {
   modstatdb_note(pkg);
   push_checkpoint(~ehflag_bombout, ehflag_normaltidy);
 
+  push_cleanup(cu_removal_dirs, ~0, NULL, 0, 0);
+
   reversefilelist_init(&rlistit,pkg->clientdata->files);
   leftover = NULL;
   while ((namenode= reversefilelist_next(&rlistit))) {
     struct filenamenode *usenode;
+    const char *name;
+    int dirfd;
 
     debug(dbg_eachfile, "removal_bulk `%s' flags=%o",
           namenode->name, namenode->flags);
@@ -340,7 +366,8 @@ static void removal_bulk_remove_leftover_dirs(struct pkginfo *pkg) {
     varbufaddstr(&fnvb, usenode->name);
     varbufaddc(&fnvb,0);
 
-    if (!stat(fnvb.buf,&stab) && S_ISDIR(stab.st_mode)) {
+    dirfd = dir_cache_open(&removal_dirs, fnvb.buf, &name);
+    if (!fstatat(dirfd, name, &stab, 0) && S_ISDIR(stab.st_mode)) {
       debug(dbg_eachfiledetail, "removal_bulk is a directory");
       /* Only delete a directory or a link to one if we're the only
        * package which uses it.  Other files should only be listed
@@ -354,7 +381,9 @@ static void removal_bulk_remove_leftover_dirs(struct pkginfo *pkg) {
     }
 
     debug(dbg_eachfiledetail, "removal_bulk removing `%s'", fnvb.buf);
-    if (!rmdir(fnvb.buf) || errno == ENOENT || errno == ELOOP) continue;
+    if (!unlinkat(dirfd, name, AT_REMOVEDIR) ||
+        errno == ENOENT || errno == ELOOP)
+      continue;
     if (errno == ENOTEMPTY || errno == EEXIST) {
       warning(_("while removing %.250s, directory '%.250s' not empty so not removed."),
               pkg->name, namenode->name);
@@ -372,6 +401,7 @@ static void removal_bulk_remove_leftover_dirs(struct pkginfo *pkg) {
     push_leftover(&leftover,namenode);
     continue;
   }
+  pop_cleanup(ehflag_normaltidy); /* cu_removal_dirs */
   write_filelist_except(pkg,leftover,0);
 
   modstatdb_note(pkg);
@@ -30,6 +30,7 @@
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/buffer.h>
 #include <dpkg/pkg-array.h>
 #include <dpkg/myopt.h>
 
@@ -80,64 +81,92 @@ void getselections(const char *const *argv) {
   pkg_array_destroy(&array);
 }
 
+/*
+ * The whole input is read in one go and parsed in place, and only the
+ * status database is written back, as the available one is neither
+ * needed nor changed, which matters when importing tens of thousands of
+ * selections. If none of them changed, nothing is written back at all.
+ */
 void setselections(const char *const *argv) {
   const struct namevalue *nvp;
   struct pkginfo *pkg;
   const char *e;
-  int c, lno;
-  struct varbuf namevb = VARBUF_INIT;
-  struct varbuf selvb = VARBUF_INIT;
+  char *p, *end, *name, *sel;
+  int lno, changed, total;
+  struct varbuf input = VARBUF_INIT;
 
   if (*argv)
     badusage(_("--%s takes no arguments"), cipaction->olong);
 
-  modstatdb_init(admindir,msdbrw_write);
+  modstatdb_init(admindir, msdbrw_write | msdbrw_noavail);
+
+  fd_vbuf_copy(0, &input, -1, _("<standard input>"));
+  varbufaddc(&input, '\0');
 
+  p = input.buf;
+  end = input.buf + input.used - 1;
   lno= 1;
+  changed = total = 0;
   for (;;) {
-    varbufreset(&namevb);
-    varbufreset(&selvb);
-    do { c= getchar(); if (c == '\n') lno++; } while (c != EOF && isspace(c));
-    if (c == EOF) break;
-    if (c == '#') {
-      do { c= getchar(); if (c == '\n') lno++; } while (c != EOF && c != '\n');
-      continue;
+    while (p < end && isspace((unsigned char)*p)) {
+      if (*p == '\n')
+        lno++;
+      p++;
     }
-    while (!isspace(c)) {
-      varbufaddc(&namevb,c);
-      c= getchar();
-      if (c == EOF) ohshit(_("unexpected eof in package name at line %d"),lno);
-      if (c == '\n') ohshit(_("unexpected end of line in package name at line %d"),lno);
+    if (p == end) break;
+    if (*p == '#') {
+      p = memchr(p, '\n', end - p);
+      if (p == NULL)
+        break;
+      continue;
     }
-    while (c != EOF && isspace(c)) {
-      c= getchar();
-      if (c == EOF) ohshit(_("unexpected eof after package name at line %d"),lno);
-      if (c == '\n') ohshit(_("unexpected end of line after package name at line %d"),lno);
+
+    name = p;
+    while (!isspace((unsigned char)*p)) {
+      p++;
+      if (p == end) ohshit(_("unexpected eof in package name at line %d"),lno);
     }
-    while (c != EOF && !isspace(c)) {
-      varbufaddc(&selvb,c);
-      c= getchar();
+    if (*p == '\n') ohshit(_("unexpected end of line in package name at line %d"),lno);
+    *p++ = '\0';
+
+    while (isspace((unsigned char)*p)) {
+      if (*p == '\n') ohshit(_("unexpected end of line after package name at line %d"),lno);
+      p++;
     }
-    while (c != EOF && c != '\n') {
-      c= getchar();
-      if (!isspace(c))
+    if (p == end) ohshit(_("unexpected eof after package name at line %d"),lno);
+
+    sel = p;
+    while (p < end && !isspace((unsigned char)*p))
+      p++;
+    while (p < end && *p != '\n') {
+      if (!isspace((unsigned char)*p))
         ohshit(_("unexpected data after package and selection at line %d"),lno);
+      *p++ = '\0';
     }
-    varbufaddc(&namevb,0);
-    varbufaddc(&selvb,0);
-    e = illegal_packagename(namevb.buf, NULL);
+    *p = '\0';
+
+    e = illegal_packagename(name, NULL);
     if (e) ohshit(_("illegal package name at line %d: %.250s"),lno,e);
-    for (nvp=wantinfos; nvp->name && strcmp(nvp->name,selvb.buf); nvp++);
-    if (!nvp->name) ohshit(_("unknown wanted status at line %d: %.250s"),lno,selvb.buf);
-    pkg= findpackage(namevb.buf);
-    pkg->want= nvp->value;
-    if (c == EOF) break;
+    for (nvp=wantinfos; nvp->name && strcmp(nvp->name,sel); nvp++);
+    if (!nvp->name) ohshit(_("unknown wanted status at line %d: %.250s"),lno,sel);
+    pkg= findpackage(name);
+    if (pkg->want != (enum pkgwant)nvp->value) {
+      pkg->want= nvp->value;
+      changed++;
+    }
+    total++;
+
+    if (p == end) break;
+    p++;
     lno++;
   }
-  if (ferror(stdin)) ohshite(_("read error on standard input"));
-  modstatdb_shutdown();
-  varbuf_destroy(&namevb);
-  varbuf_destroy(&selvb);
+  debug(dbg_general, "setselections %d of %d selections changed",
+        changed, total);
+  if (changed)
+    modstatdb_shutdown();
+  else
+    modstatdb_shutdown_unchanged();
+  varbuf_destroy(&input);
 }
 
 void clearselections(const char *const *argv)
@@ -30,8 +30,6 @@
 #include <locale.h>
 #endif
 #include <string.h>
-#include <grp.h>
-#include <pwd.h>
 #include <fnmatch.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -40,6 +38,7 @@
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/ugid.h>
 #include <dpkg/path.h>
 #include <dpkg/dir.h>
 #include <dpkg/myopt.h>
@@ -179,21 +178,20 @@ static void
 statdb_node_print(FILE *out, struct filenamenode *file)
 {
 	struct filestatoverride *filestat = file->statoverride;
-	struct passwd *pw;
-	struct group *gr;
+	const char *name;
 
 	if (!filestat)
 		return;
 
-	pw = getpwuid(filestat->uid);
-	if (pw)
-		fprintf(out, "%s ", pw->pw_name);
+	name = ugid_user_name(filestat->uid);
+	if (name)
+		fprintf(out, "%s ", name);
 	else
 		fprintf(out, "#%d ", filestat->uid);
 
-	gr = getgrgid(filestat->gid);
-	if (gr)
-		fprintf(out, "%s ", gr->gr_name);
+	name = ugid_group_name(filestat->gid);
+	if (name)
+		fprintf(out, "%s ", name);
 	else
 		fprintf(out, "#%d ", filestat->gid);
 
@@ -27,8 +27,6 @@
 
 #include <errno.h>
 #include <string.h>
-#include <pwd.h>
-#include <grp.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -36,6 +34,7 @@
 #include <dpkg/i18n.h>
 #include <dpkg/dpkg.h>
 #include <dpkg/dpkg-db.h>
+#include <dpkg/ugid.h>
 #include <dpkg/buffer.h>
 
 #include "filesdb.h"
@@ -57,11 +56,9 @@ statdb_parse_uid(const char *str)
 			ohshit(_("syntax error: invalid uid in statoverride file"));
 		uid = (uid_t)value;
 	} else {
-		struct passwd* pw = getpwnam(str);
-		if (pw == NULL)
+		if (!ugid_user_id(str, &uid))
 			ohshit(_("syntax error: unknown user '%s' in statoverride file"),
 			       str);
-		uid = pw->pw_uid;
 	}
 
 	return uid;
@@ -81,11 +78,9 @@ statdb_parse_gid(const char *str)
 			ohshit(_("syntax error: invalid gid in statoverride file"));
 		gid = (gid_t)value;
 	} else {
-		struct group* gr = getgrnam(str);
-		if (gr == NULL)
+		if (!ugid_group_id(str, &gid))
 			ohshit(_("syntax error: unknown group '%s' in statoverride file"),
 			       str);
-		gid = gr->gr_gid;
 	}
 
 	return gid;
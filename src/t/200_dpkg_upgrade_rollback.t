@@ -0,0 +1,160 @@
+# -*- mode: cperl;-*-
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+use Test::More;
+use File::Basename;
+use File::Find;
+use File::Path;
+use File::Spec;
+
+use strict;
+use warnings;
+
+my $srcdir = $ENV{srcdir} || '.';
+my $builddir = $ENV{builddir} || '.';
+my $tmpdir = File::Spec->rel2abs('t.tmp/200_dpkg_upgrade_rollback');
+my $instdir = "$tmpdir/instdir";
+my $admindir = "$instdir/var/lib/dpkg";
+
+my $dpkg = File::Spec->rel2abs("$builddir/../src/dpkg");
+my $dpkg_deb = File::Spec->rel2abs("$builddir/../dpkg-deb/dpkg-deb");
+
+if (! -x $dpkg or ! -x $dpkg_deb) {
+    plan skip_all => "dpkg or dpkg-deb not available";
+    exit(0);
+}
+
+# The maintainer scripts get run chrooted into the instdir.
+if ($> != 0) {
+    plan skip_all => "maintainer scripts can only be run chrooted as root";
+    exit(0);
+}
+
+sub write_file {
+    my ($file, $content, $mode) = @_;
+
+    open(my $fh, '>', $file) or die "cannot create $file: $!\n";
+    print $fh $content;
+    close($fh);
+    chmod($mode, $file) if defined $mode;
+}
+
+sub read_file {
+    my ($file) = @_;
+
+    open(my $fh, '<', $file) or return undef;
+    local $/;
+    my $content = <$fh>;
+    close($fh);
+
+    return $content;
+}
+
+# Copy the shell and the shared libraries it needs into the instdir, so
+# that the maintainer scripts can be run from there.
+sub install_shell {
+    my @files = ('/bin/sh');
+
+    open(my $ldd, '-|', 'ldd /bin/sh 2>/dev/null') or return 0;
+    while (<$ldd>) {
+        push @files, $1 if m{(/\S+)};
+    }
+    close($ldd);
+
+    foreach my $file (@files) {
+        mkpath("$instdir" . dirname($file));
+        system('cp', '-L', $file, "$instdir$file") == 0 or return 0;
+    }
+    chmod(0755, "$instdir/bin/sh");
+
+    return 1;
+}
+
+sub build_package {
+    my ($version, %scripts) = @_;
+    my $dir = "$tmpdir/pkg-a-$version";
+    my $deb = "$tmpdir/pkg-a_${version}_all.deb";
+
+    mkpath(["$dir/DEBIAN", "$dir/usr/share/pkg-a"]);
+    write_file("$dir/DEBIAN/control", "Package: pkg-a
+Version: $version
+Architecture: all
+Maintainer: Test <test\@example.org>
+Description: test package
+ This package tests the rollback of a failed upgrade.
+");
+    foreach my $script (keys %scripts) {
+        write_file("$dir/DEBIAN/$script", $scripts{$script}, 0755);
+    }
+    write_file("$dir/usr/share/pkg-a/file", "pkg-a $version\n");
+
+    # The in-tree dpkg-deb might not work with the tar found on the
+    # system, in which case we try with the one from the system.
+    foreach my $build_with ($dpkg_deb, 'dpkg-deb') {
+        return $deb if system("$build_with -Zgzip --build $dir $deb " .
+                              ">/dev/null 2>&1") == 0;
+    }
+
+    return undef;
+}
+
+sub call_dpkg {
+    my (@args) = @_;
+
+    local $ENV{PATH} = dirname($dpkg_deb) . ":$ENV{PATH}";
+
+    return system("$dpkg --instdir=$instdir --admindir=$admindir " .
+                  "--force-not-root --force-bad-path @args " .
+                  ">/dev/null 2>&1");
+}
+
+### Tests
+
+rmtree($tmpdir);
+mkpath(["$admindir/info", "$admindir/updates"]);
+write_file("$admindir/status", '');
+write_file("$admindir/available", '');
+
+my $old = build_package('1.0', postrm => '#!/bin/sh
+[ "$1" = upgrade ] && exit 1
+exit 0
+');
+my $new = build_package('2.0');
+
+if (not defined $old or not defined $new or not install_shell()) {
+    plan skip_all => "cannot set up the packages or the instdir";
+    exit(0);
+}
+
+plan tests => 5;
+
+ok(call_dpkg('--install', $old) == 0, "old version gets installed");
+
+# The old postrm fails on upgrade after the new version has been
+# extracted, and the new one has no postrm to fall back to, so the
+# files must get rolled back from their backups.
+ok(call_dpkg('--install', $new) != 0, "upgrade fails on the old postrm");
+
+is(read_file("$instdir/usr/share/pkg-a/file"), "pkg-a 1.0\n",
+   "file contents rolled back to the old version");
+
+my @leftovers;
+find(sub { push @leftovers, $File::Find::name if /\.dpkg-(tmp|new)$/ },
+     "$instdir/usr");
+is_deeply(\@leftovers, [], "no backup or new files left over");
+
+like(read_file("$admindir/status"),
+     qr/^Package: pkg-a\nStatus: install ok installed\n(.+\n)*Version: 1\.0\n/m,
+     "old version still installed");
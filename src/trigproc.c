@@ -26,6 +26,7 @@
 #include <sys/stat.h>
 
 #include <assert.h>
+#include <string.h>
 #include <stdlib.h>
 
 #include <dpkg/i18n.h>
@@ -33,6 +34,7 @@
 #include <dpkg/dpkg-db.h>
 #include <dpkg/pkg-queue.h>
 #include <dpkg/triglib.h>
+#include <dpkg/timing.h>
 
 #include "main.h"
 #include "filesdb.h"
@@ -67,7 +69,11 @@
  * argument queue (the add_to_queue queue) and check what its state is
  * and if appropriate we trigproc it.  If we didn't have a queue (or had
  * just --pending) we search all triggers-pending packages and add them
- * to the deferred trigproc list.
+ * to the deferred trigproc list.  For --configure (and --install) a
+ * triggers-pending package in the argument queue is moved to the
+ * deferred trigproc list instead of being processed straight away, so
+ * that activations from the packages configured after it are coalesced
+ * into a single run of its postinst.
  *
  *
  * Before quitting from most operations, we trigproc each package in the
@@ -84,13 +90,84 @@
  *
  */
 
+/*========== trigger statistics ==========*/
+
+/*
+ * Activations of the same trigger are coalesced into the single
+ * Triggers-Pending entry of the interested package, and only processed
+ * when that package gets to run its postinst. These counters record how
+ * many activations each trigger received and how many times it was
+ * actually processed, so the difference is the work that was saved.
+ */
+struct trigstats {
+	struct trigstats *next;
+	const char *name;
+	int activated;
+	int processed;
+};
+
+/* This is looked up on every activation, and a package can easily be
+ * interested in hundreds of file triggers, so keep it hashed. */
+#define TRIGSTATS_BINS 256
+
+static struct trigstats *trigstats[TRIGSTATS_BINS];
+
+static unsigned int
+trigstats_hash(const char *name)
+{
+	unsigned int h = 0;
+
+	while (*name)
+		h = h * 31 + (unsigned char)*name++;
+
+	return h % TRIGSTATS_BINS;
+}
+
+static struct trigstats *
+trigstats_find(const char *name)
+{
+	struct trigstats *ts, **bin;
+
+	bin = &trigstats[trigstats_hash(name)];
+	for (ts = *bin; ts; ts = ts->next)
+		if (ts->name == name || strcmp(ts->name, name) == 0)
+			return ts;
+
+	ts = nfmalloc(sizeof(*ts));
+	/* Like the Triggers-Pending entries, trigger names are not copied. */
+	ts->name = name;
+	ts->activated = 0;
+	ts->processed = 0;
+	ts->next = *bin;
+	*bin = ts;
+
+	return ts;
+}
+
+static void
+trigstats_report(void)
+{
+	struct trigstats *ts;
+	int i;
+
+	for (i = 0; i < TRIGSTATS_BINS; i++)
+		for (ts = trigstats[i]; ts; ts = ts->next)
+			debug(dbg_triggers,
+			      "trigger %s activated %d times, processed %d "
+			      "times, %d coalesced", ts->name, ts->activated,
+			      ts->processed, ts->activated > ts->processed ?
+			      ts->activated - ts->processed : 0);
+}
+
 /*========== deferred trigger queue ==========*/
 
 static struct pkg_queue deferred = PKG_QUEUE_INIT;
 
 static void
-trigproc_enqueue_deferred(struct pkginfo *pend)
+trigproc_enqueue_deferred(struct pkginfo *pend, const char *trig)
 {
+	trigstats_find(trig)->activated++;
+
 	if (f_triggers < 0)
 		return;
 	ensure_package_clientdata(pend);
@@ -100,6 +177,27 @@ trigproc_enqueue_deferred(struct pkginfo *pend)
 	debug(dbg_triggers, "trigproc_enqueue_deferred pend=%s", pend->name);
 }
 
+/**
+ * Postpone the trigger processing of a package to trigproc_run_deferred().
+ *
+ * Returns false if that is not possible because deferred processing is
+ * disabled, in which case the caller should process the triggers now.
+ */
+bool
+trigproc_defer(struct pkginfo *pkg)
+{
+	if (f_triggers < 0)
+		return false;
+
+	ensure_package_clientdata(pkg);
+	if (!pkg->clientdata->trigprocdeferred)
+		pkg->clientdata->trigprocdeferred = pkg_queue_push(&deferred,
+		                                                   pkg);
+	debug(dbg_triggers, "trigproc_defer pkg=%s", pkg->name);
+
+	return true;
+}
+
 void
 trigproc_run_deferred(void)
 {
@@ -125,6 +223,8 @@ trigproc_run_deferred(void)
 		set_error_display(NULL, NULL);
 		error_unwind(ehflag_normaltidy);
 	}
+
+	trigstats_report();
 }
 
 void
@@ -301,6 +401,8 @@ trigproc(struct pkginfo *pkg)
 		if (gaveup == pkg)
 			return;
 
+		timing_start(timing_trigproc);
+
 		printf(_("Processing triggers for %s ...\n"), pkg->name);
 		log_action("trigproc", pkg);
 
@@ -308,6 +410,7 @@ trigproc(struct pkginfo *pkg)
 		for (tp = pkg->trigpend_head; tp; tp = tp->next) {
 			varbufaddc(&namesarg, ' ');
 			varbufaddstr(&namesarg, tp->name);
+			trigstats_find(tp->name)->processed++;
 		}
 		varbufaddc(&namesarg, 0);
 
@@ -329,6 +432,8 @@ trigproc(struct pkginfo *pkg)
 		              stat_installed;
 
 		post_postinst_tasks_core(pkg);
+
+		timing_stop(timing_trigproc);
 	} else {
 		/* In other branch is done by modstatdb_note. */
 		trig_clear_awaiters(pkg);